@@ -0,0 +1,197 @@
+/*
+  The purpose of this program is to write the convolution kernels
+  of ProgramOMP.c specialized for the given lengths
+  of the unit sputter yield.
+
+  The number of taps is a constant in each kernel,
+  so that the taps are unrolled by N_UNROLL without counting
+  the loop, and the remainder is written down one by one.
+  ProgramOMP.c uses them when it is compiled with -DFIXED_KERNELS
+  and the loaded unit has one of the lengths,
+  otherwise the kernels for any length are used.
+
+
+// Usage
+  ./GenerateKernels 171 1561 > FixedKernels.inc
+  The lengths should be odd, because ProgramOMP.c removes
+  the last element of the unit of an even length.
+  "make OMPFixedDeconvolution" does the above with FIXED_N_UNI
+  in the Makefile.
+ */
+
+#include<stdio.h>
+#include<stdlib.h>
+
+#define N_UNROLL 8
+#define N_ISA    3
+
+// The instructions to write down a kernel
+typedef struct
+{
+  const char *name;    // CorrelateRow<name>
+  const char *target;  // __attribute__((target(...)))
+  const char *simd;    // SIMD_xxx in ProgramOMP.c
+  const char *vec;     // type of a vector
+  int         width;   // doubles in a vector
+  const char *zero;
+  const char *set1;    // broadcast u[%s]
+  const char *fma;     // a%d += w*x[k+%s+%d] (a%d)
+} Isa;
+
+int WriteGeneric(FILE *fp, int n);
+int WriteKernel(FILE *fp, const Isa *isa, int n);
+int WriteTap(FILE *fp, const Isa *isa, const char *j, int indent);
+int WriteTable(FILE *fp, const Isa *isa, int n_len, int *len);
+
+int main (int argc, char *argv[])
+{
+  int i, k, n_len = argc-1;
+  int *len;
+  const Isa isa[N_ISA] =
+  {
+    {"SSE2", "sse2", "SIMD_SSE2", "__m128d", 2,
+      "_mm_setzero_pd()", "_mm_set1_pd(u[%s])",
+      "a%d = _mm_add_pd(_mm_mul_pd(w, _mm_loadu_pd(x+k+%s+%d)), a%d);"},
+    {"AVX2", "avx2,fma", "SIMD_AVX2", "__m256d", 4,
+      "_mm256_setzero_pd()", "_mm256_broadcast_sd(u+%s)",
+      "a%d = _mm256_fmadd_pd(w, _mm256_loadu_pd(x+k+%s+%d), a%d);"},
+    {"AVX512", "avx512f", "SIMD_AVX512", "__m512d", 8,
+      "_mm512_setzero_pd()", "_mm512_set1_pd(u[%s])",
+      "a%d = _mm512_fmadd_pd(w, _mm512_loadu_pd(x+k+%s+%d), a%d);"},
+  };
+  if (n_len < 1)
+  {
+    fprintf(stderr, "Give the lengths of the unit.\n");
+    return 1;
+  }
+  len = (int*)malloc(sizeof(int)*n_len);
+  for (i=0; i<n_len; i++)
+  {
+    len[i] = atoi(argv[i+1]);
+    if (len[i] < 1 || len[i]%2 == 0)
+    {
+      fprintf(stderr, "Invalid length of the unit: %s\n", argv[i+1]);
+      return 1;
+    }
+  }
+  printf("// Written by GenerateKernels; do not edit.\n");
+  for (i=0; i<n_len; i++)
+  {
+    WriteGeneric(stdout, len[i]);
+  }
+  printf("#ifdef SIMD_X86\n");
+  for (k=0; k<N_ISA; k++)
+  {
+    for (i=0; i<n_len; i++)
+    {
+      WriteKernel(stdout, &isa[k], len[i]);
+    }
+  }
+  printf("#endif\n");
+  WriteTable(stdout, isa, n_len, len);
+  free(len);
+  return 0;
+}
+// the compiler vectorizes the taps of the constant number
+int WriteGeneric(FILE *fp, int n)
+{
+  fprintf(fp,
+    "void CorrelateRowGeneric_%d(const double *u, int n_u, \n"
+    "    const double *x, double *y, int n_y)\n"
+    "{\n"
+    "  int    j, k;\n"
+    "  double sum;\n"
+    "  for (k=0; k<n_y; k++)\n"
+    "  {\n"
+    "    sum = 0.0;\n"
+    "#pragma omp simd reduction(+:sum)\n"
+    "    for (j=0; j<%d; j++)\n"
+    "    {\n"
+    "      sum += u[j]*x[k+j];\n"
+    "    }\n"
+    "    y[k] = sum;\n"
+    "  }\n"
+    "}\n", n, n);
+  return 0;
+}
+// four vectors of successive y are accumulated as in ProgramOMP.c,
+//   and the rest of y is left to the kernel for any length
+int WriteKernel(FILE *fp, const Isa *isa, int n)
+{
+  int  t, n_unr = (n / N_UNROLL) * N_UNROLL;
+  char j[32];
+  fprintf(fp,
+    "__attribute__((target(\"%s\")))\n"
+    "void CorrelateRow%s_%d(const double *u, int n_u, \n"
+    "    const double *x, double *y, int n_y)\n"
+    "{\n"
+    "  int     %sk;\n"
+    "  %s w, a0, a1, a2, a3;\n"
+    "  for (k=0; k+%d<=n_y; k+=%d)\n"
+    "  {\n"
+    "    a0 = a1 = a2 = a3 = %s;\n",
+    isa->target, isa->name, n, (n_unr > 0) ? "j, " : "", isa->vec,
+    4*isa->width, 4*isa->width, isa->zero);
+  if (n_unr > 0)
+  {
+    fprintf(fp, "    for (j=0; j<%d; j+=%d)\n    {\n", n_unr, N_UNROLL);
+    for (t=0; t<N_UNROLL; t++)
+    {
+      sprintf(j, "j+%d", t);
+      WriteTap(fp, isa, j, 6);
+    }
+    fprintf(fp, "    }\n");
+  }
+  for (t=n_unr; t<n; t++)
+  {
+    sprintf(j, "%d", t);
+    WriteTap(fp, isa, j, 4);
+  }
+  for (t=0; t<4; t++)
+  {
+    fprintf(fp, "    _mm%s_storeu_pd(y+k+%d, a%d);\n",
+        (isa->width == 2) ? "" : (isa->width == 4) ? "256" : "512",
+        t*isa->width, t);
+  }
+  fprintf(fp,
+    "  }\n"
+    "  CorrelateRow%s(u, n_u, x+k, y+k, n_y-k);\n"
+    "}\n", isa->name);
+  return 0;
+}
+// w = u[j], and a0-a3 += w*x[k+j+...]
+int WriteTap(FILE *fp, const Isa *isa, const char *j, int indent)
+{
+  int a;
+  fprintf(fp, "%*sw  = ", indent, "");
+  fprintf(fp, isa->set1, j);
+  fprintf(fp, ";\n");
+  for (a=0; a<4; a++)
+  {
+    fprintf(fp, "%*s", indent, "");
+    fprintf(fp, isa->fma, a, j, a*isa->width, a);
+    fprintf(fp, "\n");
+  }
+  return 0;
+}
+int WriteTable(FILE *fp, const Isa *isa, int n_len, int *len)
+{
+  int i, k;
+  fprintf(fp, "const FixedKernel fixed_kernels[] =\n{\n");
+  for (i=0; i<n_len; i++)
+  {
+    fprintf(fp, "  {%d, SIMD_GENERIC, CorrelateRowGeneric_%d},\n",
+        len[i], len[i]);
+  }
+  fprintf(fp, "#ifdef SIMD_X86\n");
+  for (k=0; k<N_ISA; k++)
+  {
+    for (i=0; i<n_len; i++)
+    {
+      fprintf(fp, "  {%d, %s, CorrelateRow%s_%d},\n",
+          len[i], isa[k].simd, isa[k].name, len[i]);
+    }
+  }
+  fprintf(fp, "#endif\n  {0, 0, NULL}\n};\n");
+  return 0;
+}
@@ -50,15 +50,298 @@
     lim_alpha determines the lower limit of alpha.
     Even when alpha is repeatedly multiplied by ls_alpha,
     alpha cannot be less than lim_alpha.
+  mr_alpha, n_grow:
+    mr_alpha enlarges alpha of STEP_SHRINK after n_grow steps
+    lessening the errors in a row, so that alpha lessened 
+    by ls_alpha early grows again (as ALPHABOOST 
+    of Program_extended.cs), which is checked again 
+    by the following steps. mr_alpha = 1 (the default) keeps 
+    alpha from growing as before; try 1.05 for example.
+    alpha is not enlarged beyond 1/L, where L = (sum of |unit|)^2 
+    bounds |unit * dwell time|^2 / |dwell time|^2, since longer 
+    steps than that may worsen the errors.
+    The times alpha is enlarged and lessened are displayed 
+    at the end.
   threshold:
     Change the threshold to escape from the loop calculation 
     when the shape errors are reduced to this value in RMS.
+  rel_tol:
+    The loop also stops when the errors in RMS are lessened 
+    by less than rel_tol (relative) over the last N_WINDOW checks,
+    which are made every N_LOOPCHECK loops.
+    Each check convolutes the figure of the dwell time 
+    and correlates the errors with the unit (the gradient).
+  grd_tol:
+    When grd_tol is more than zero, the loop also stops 
+    when the gradient (err x unit) at a check is less than 
+    grd_tol of that at the initial dwell time, or its projection 
+    is, which leaves out the samples held at offset_time 
+    with the gradient going below (the optimality with the bound).
+    The reason to stop is displayed at the end.
   offset_time:
     offset_time determines the lower limit of dwell time.
     This should be more than zero, and can consider
     the minimum duration in transfer of the stage.
   offset_hgt:
     offset_hgt adjust the height of the imported files.
+  trim_tail:
+    When trim_tail is more than zero, the tails of the unit 
+    sputter yield are cut off symmetrically about its center,
+    as long as they hold less than trim_tail of the energy
+    (the sum of squares) of the unit, e.g. 1E-6.
+    The shorter unit reduces n_uni, and n_all with it,
+    before the arrays are allocated.
+    The energy and the volume cut off are displayed.
+  conv_mode:
+    conv_mode selects how the unit sputter yield is convoluted
+    with the dwell time and correlated with the errors.
+    CONV_DIRECT computes the sums directly in O(n_all*n_uni),
+    and is kept as the reference.
+    Each element of the results gathers the products 
+    over its own window, so that the threads write down 
+    separate elements without reduction.
+    The rows and the taps of the unit are computed in tiles
+    sized from the L1 cache of the CPU.
+    "make OMPFixedDeconvolution" compiles this program 
+    with -DFIXED_KERNELS and the kernels written by 
+    GenerateKernels for the lengths of FIXED_N_UNI in Makefile.
+    When n_uni is one of them, CONV_DIRECT (in double) 
+    uses the kernel of the constant number of taps.
+    CONV_SCATTER adds the products of each element 
+    to the results with the reduction of the whole arrays,
+    which was the original form, for comparison.
+    CONV_FFT multiplies the spectra of the arrays
+    by the spectrum of the unit computed once in advance,
+    which takes O(n_all*log(n_all)).
+    CONV_SEGMENT cuts the arrays into segments (overlap-save)
+    and transforms them separately with the spectrum
+    of the unit for the length of a segment.
+    The segments are as long as the L2 cache holds,
+    and shared among the threads,
+    which suits the targets of millions of samples or more.
+    CONV_AUTO times CONV_DIRECT, CONV_FFT and CONV_SEGMENT 
+    once at the beginning, and uses the fastest one.
+    CONV_DIRECT is faster for short units 
+    (less than several hundreds of samples).
+  simd_mode:
+    simd_mode selects the vector instructions 
+    used in CONV_DIRECT.
+    SIMD_AUTO chooses the widest ones of the running CPU
+    among SSE2, AVX2 (with FMA) and AVX-512,
+    so that the same executable runs on any x86 machine.
+    The others force the instructions, and SIMD_GENERIC 
+    leaves the vectorization to the compiler.
+  normal_eq:
+    When normal_eq is VALID, the update (err x unit) is obtained
+    from the normal equation, 
+      update = (unit x target) - (unit x unit x dwell time),
+    where (unit x target) and the autocorrelation of the unit 
+    (unit x unit) are computed only once.
+    Each loop convolutes the dwell time only once,
+    and the RMS is given by the inner products.
+    The figure out of the target is subtracted directly
+    in O(n_uni*n_uni) with the tiled kernels.
+    With CONV_FFT and CONV_SEGMENT, this halves the transforms 
+    of a loop, which is about twice as fast when the target is 
+    much longer than the unit (8000 samples and a unit of 171), 
+    and still faster with the sample input (363 and 171).
+    With CONV_DIRECT, (unit x unit) has twice the taps of the unit,
+    so that it costs as much as the convolution and the correlation
+    and does not pay; the margins make it slower with short targets.
+    normal_eq is computed in double precision (prec_mode ignored).
+  incr_fig:
+    When incr_fig is VALID, the figure is not convoluted again 
+    after each step, but refreshed as 
+      real_fig + alpha*(unit * update),
+    where (unit * update) is convoluted once for each update.
+    The dwell time cut by offset_time is corrected 
+    only around those samples.
+    A step worsening the errors is discarded 
+    and retried with the lessened alpha, 
+    which costs O(n_all) instead of a convolution.
+    normal_eq is ignored with incr_fig.
+  backtrack:
+    When backtrack is VALID, a step of STEP_SHRINK (without 
+    incr_fig) is accepted only when the errors are lessened 
+    enough (Armijo),
+      |error_new|^2 <= |error|^2 - 2*BT_GAMMA*(update, step),
+    where step is the change of the dwell time cut by offset_time.
+    Otherwise the step is discarded, and retried from the dwell 
+    time, the figure and the errors kept from the last accepted 
+    step with alpha lessened by ls_alpha, without correlating 
+    the errors again, so that the errors never increase.
+    The steps rejected (also by incr_fig) are displayed at the end.
+    The loop stops when a step is rejected with alpha 
+    which cannot be lessened below lim_alpha any more.
+    normal_eq is ignored with backtrack.
+  active_set:
+    When active_set is VALID, STEP_SHRINK keeps the samples 
+    held at offset_time with the update going below 
+    (the active set), which the step would cut back 
+    to offset_time anyway.
+    CONV_DIRECT skips the rows of those samples in the correlation 
+    of the errors with the unit, and leaves their update zero.
+    The set is refreshed by the correlation of all the samples 
+    every N_LOOPACTIVE correlations, and a sample released 
+    in the meantime waits for it.
+    The other conv_mode computes all the samples in any case.
+    The size of the set is displayed with the loop.
+    active_set is ignored with normal_eq and step_mode.
+  prec_mode:
+    prec_mode selects the precision of CONV_DIRECT.
+    PREC_SINGLE computes the convolutions in float,
+    which doubles the elements in a vector 
+    and halves the memory to be read.
+    The arrays are kept in double, and the sums of the tiles 
+    are added up in double.
+    While the float kernels are used, a step worsening the RMS 
+    by less than its rounding errors (ROUND_SINGLE) is taken 
+    as a step lessening it, and alpha is kept.
+    PREC_MIXED starts with float, and switches to double 
+    when the errors in RMS fall below MIXED_RMS*threshold,
+    when a step worsens the errors, or when the loop stalls.
+    alpha is not lessened while PREC_MIXED runs in float,
+    since the rounding errors rather than alpha worsen the step.
+    The final figure is computed in double in any case.
+  step_mode:
+    step_mode selects how the step size alpha is given.
+    STEP_SHRINK keeps alpha, and lessens it by ls_alpha 
+    after a step worsening the errors.
+    STEP_EXACT gives alpha minimizing the errors along 
+    the update in each loop, 
+      alpha = |update|^2 / |unit * update|^2,
+    where (unit * update) is convoluted once for each update,
+    and the figure is refreshed with it as in incr_fig.
+    The dwell time below offset_time is cut after the step.
+    STEP_PROJECTED does not move the samples held 
+    at offset_time, and takes the best point on the way 
+    to the step cut by offset_time, which never worsens 
+    the errors.
+    STEP_BB gives the spectral step of Barzilai and Borwein
+    from the last two dwell times and updates,
+      alpha = |s|^2 / (s, update_prev - update),
+    where s is the difference of the dwell times.
+    The step is accepted when the errors are less than 
+    the worst of the last N_NONMONO steps (nonmonotone),
+    otherwise alpha is lessened to the minimum of the quadratic
+    fitted to the errors (BB_SHRINK at most) and retried.
+    STEP_FISTA adds the momentum of Nesterov (FISTA) 
+    to the steps cut by offset_time, with alpha = 1/L,
+    where L = (sum of |unit|)^2 bounds |unit * dwell time|^2
+    for a dwell time of the unit norm.
+    The momentum is restarted as chosen by restart_mode.
+    STEP_CG runs the conjugate gradient on the free samples,
+    while the samples held at offset_time 
+    (with the update going below) are fixed.
+    A step going below offset_time is cut and taken 
+    as in STEP_PROJECTED, and the conjugate gradient restarts 
+    from the update (a gradient projection step) 
+    whenever the samples held at offset_time change.
+    The samples to go up from offset_time are released 
+    only at the restarts.
+    STEP_LBFGSB is a quasi-Newton method for the lower bound 
+    (L-BFGS-B), which keeps the last n_hist differences 
+    of the dwell time and the update.
+    The direction from them is taken on the free samples 
+    as in STEP_CG, and the step is searched exactly 
+    along it and cut by offset_time as in STEP_PROJECTED.
+    STEP_RL multiplies the dwell time above offset_time by
+      (unit x (target / real_fig)) / (unit x 1)
+    as in Richardson-Lucy, which keeps it above offset_time 
+    without cutting it, and needs no alpha.
+    Since the samples at offset_time cannot move, the dwell time
+    is raised above offset_time at first by the mean of the errors
+    divided by the sum of the unit.
+    The target (with offset_hgt) and the unit should be positive.
+    STEP_RLACC extrapolates the dwell time of STEP_RL along 
+    the last step (Biggs and Andrews), by the ratio of the last 
+    two steps less than RL_ACCEL, and the extrapolation restarts 
+    when the errors worsen. alpha displays 1 + the ratio.
+    The initial alpha is used only for the first step of STEP_BB,
+    and normal_eq and incr_fig are ignored with step_mode.
+  pre_eps:
+    When pre_eps is more than zero, the update of STEP_EXACT,
+    STEP_PROJECTED and STEP_CG (preconditioned CG) is filtered by 
+    the circulant approximation of (unit x unit + pre_eps*L)^-1,
+      IFFT( FFT(update) / (|FFT(unit)|^2 + pre_eps*L) ),
+    where L is the maximum of |FFT(unit)|^2,
+    before the step size is searched along it.
+    The fixed samples and the margins stay out of the filtered 
+    update, so that the steps are cut by offset_time as before.
+    The smaller pre_eps amplifies the higher frequencies, 
+    where the unit has little power, e.g. 1E-3.
+    The filtered direction of STEP_CG spreads over more samples 
+    held at offset_time, which restart it more often; on the 
+    sample input it speeds up STEP_PROJECTED about ten times, 
+    but STEP_CG needs fewer loops without it.
+  wnr_eps:
+    When wnr_eps is more than zero, the loop starts from 
+    the regularized (Wiener) inverse of the errors 
+    of the constant offset_time,
+      offset_time + IFFT( FFT(unit x error) 
+        / (|FFT(unit)|^2 + wnr_eps*L) ),
+    with the filter of pre_eps, cut by offset_time,
+    instead of the constant offset_time, e.g. 1E-2.
+    It replaces the guess file of ProgramOMP_init.c,
+    and is kept only when it lessens the errors.
+    wnr_eps is ignored with n_level, 
+    whose coarser levels give the initial dwell time.
+  n_level:
+    When n_level is more than one, the target and the unit 
+    are downsampled by 2^(n_level-1), ..., 2, and deconvoluted 
+    in turn from the coarsest level with the same step_mode,
+    before the loop of the original level.
+    The target is averaged over 2^l samples at the level l,
+    and the unit is convoluted with the boxes of 2^l samples
+    on both sides and downsampled, so that the figure 
+    of the constant dwell time is as high as the original.
+    The dwell time of each level is interpolated linearly 
+    to the next finer level as its initial dwell time,
+    instead of giving a guess file to ProgramOMP_init.c.
+    The level l stops when its errors in RMS are lessened 
+    by less than LEVEL_RTOL (or rel_tol if larger) over 
+    N_WINDOW checks, when the gradient falls below grd_tol,
+    or when the errors fall below threshold*2^l,
+    and after N_LOOPLEVEL loops at most.
+  n_hist:
+    n_hist is the number of the steps kept in STEP_LBFGSB,
+    which costs 2*n_hist arrays of n_all.
+  restart_mode:
+    restart_mode selects when STEP_FISTA restarts the momentum.
+    RESTART_FUNC discards a step worsening the errors,
+    and restarts from the last dwell time.
+    RESTART_GRAD restarts when the step goes against
+    the momentum, (y - dwell time, dwell time - previous) > 0,
+    where y is the point moved by the momentum.
+    The number of the restarts (also of STEP_CG and STEP_RLACC) 
+    is displayed at the end,
+    with the convolutions computed and the wall time.
+
+
+// Command-line arguments
+  Some parameters can be changed without compiling this program
+  by giving a keyword and a value as the arguments.
+    -conv   direct|fft|scatter|auto|segment : conv_mode
+    -normal on|off             : normal_eq
+    -simd   auto|generic|sse2|avx2|avx512 : simd_mode
+    -incr   on|off             : incr_fig
+    -backtrack on|off          : backtrack
+    -active on|off             : active_set
+    -grow   (a ratio)          : mr_alpha
+    -streak (an integer)       : n_grow
+    -prec   double|single|mixed : prec_mode
+    -trim   (a fraction)        : trim_tail
+    -step   shrink|exact|projected|bb|fista|cg|lbfgsb|rl|rlacc 
+                               : step_mode
+    -restart func|grad         : restart_mode
+    -hist   (an integer)       : n_hist
+    -levels (an integer)       : n_level
+    -precond (a fraction)      : pre_eps
+    -warm   (a fraction)       : wnr_eps
+    -threshold (a height)      : threshold
+    -rtol   (a fraction)       : rel_tol
+    -gtol   (a fraction)       : grd_tol
+  e.g. ./OMPDeconvolution -conv direct
 
 
 // Some useful arguments
@@ -77,7 +360,44 @@
   N_LOOPDISP:
     The interval between displaying the results.
     The results include the iterative times,
-    alpha, and error in rms.
+    alpha, error in rms, and the wall time.
+  MIXED_RMS:
+    PREC_MIXED switches to double precision 
+    when the errors in RMS fall below MIXED_RMS*threshold
+    (or earlier, after a step worsening the errors).
+  ROUND_SINGLE:
+    The rounding errors in RMS of the float kernels, 
+    relative to the RMS of the target (with offset_hgt).
+  N_LOOPFIG:
+    The interval (in the accepted steps) between convoluting 
+    the figure from scratch with incr_fig, STEP_EXACT or STEP_CG,
+    which removes the rounding errors accumulated.
+  N_LOOPLEVEL:
+    The maximum number of loops at each downsampled level 
+    with n_level, which is only a safety cap.
+  LEVEL_RTOL:
+    rel_tol of each downsampled level with n_level, 
+    since the coarse solution needs not to converge 
+    as far as the original one.
+  N_NONMONO:
+    The number of the last steps whose worst errors 
+    a step of STEP_BB should be less than.
+  BB_SHRINK:
+    STEP_BB multiplies alpha by BB_SHRINK at most 
+    when a step is rejected.
+  RL_ACCEL:
+    The upper limit of the extrapolation of STEP_RLACC.
+  N_LOOPACTIVE:
+    The interval (in the correlations) between refreshing 
+    the active set with active_set.
+  BT_GAMMA:
+    The fraction of the decrease expected from the gradient 
+    that a step of backtrack should attain.
+  N_LOOPCHECK:
+    The interval between the checks of rel_tol and grd_tol.
+  N_WINDOW:
+    The number of the last checks over which the errors in RMS
+    should be lessened by rel_tol.
  */
 
 #include<stdio.h>
@@ -86,7 +406,13 @@
 #include<stdlib.h>
 #include<time.h>
 #include<sys/time.h>
+#include<sys/resource.h>
+#include<unistd.h>
 #include<omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include<immintrin.h>
+#endif
 #define DEBUG_PRINT_INT(a) (printf("%s: %d\n", #a, a))
 #define DEBUG_PRINT_DBL(a) (printf("%s: %30.24lf\n", #a, a))
 #define SPRINTF_FILENAME(filename, state,  a) \
@@ -111,6 +437,189 @@
 #define N_nuni 2
 #define N_nall 3
 #define MS_TO_MIN 60000.0
+#define CONV_DIRECT 0
+#define CONV_FFT    1
+#define CONV_SCATTER 2
+#define CONV_AUTO    3
+#define CONV_SEGMENT 4
+#define SPC_CONV 0
+#define SPC_CORR 1
+#define SPC_REAL 2
+#define PREC_DOUBLE 0
+#define PREC_SINGLE 1
+#define PREC_MIXED  2
+#define MIXED_RMS   2.0
+#define ROUND_SINGLE 1.0E-7
+#define SIMD_AUTO    0
+#define SIMD_GENERIC 1
+#define SIMD_SSE2    2
+#define SIMD_AVX2    3
+#define SIMD_AVX512  4
+#define N_ROWBLOCK 1024
+#define N_LOOPFIG  1E3
+#define STEP_SHRINK    0
+#define STEP_EXACT     1
+#define STEP_PROJECTED 2
+#define STEP_BB        3
+#define STEP_FISTA     4
+#define STEP_CG        5
+#define STEP_LBFGSB    6
+#define STEP_RL        7
+#define STEP_RLACC     8
+#define N_LOOPLEVEL 5E5
+#define LEVEL_RTOL  2E-2
+#define RESTART_FUNC 0
+#define RESTART_GRAD 1
+#define N_NONMONO  30
+#define BB_SHRINK  0.5
+#define BB_GAMMA   1E-4
+#define RL_ACCEL   0.95
+#define BT_GAMMA   1E-4
+#define N_LOOPACTIVE 1E2
+#define N_LOOPCHECK 1E3
+#define N_WINDOW   10
+#define STOP_NONE      0
+#define STOP_THRESHOLD 1
+#define STOP_LOOPMAX   2
+#define STOP_STALL     3
+#define STOP_GRADIENT  4
+#define STOP_PROJECTED 5
+#define STOP_ALPHA     6
+#define OPT_INT 0
+#define OPT_DBL 1
+#define OPT_KEY 2
+// A keyword and a variable to be changed by the arguments
+typedef struct
+{
+  const char *name; // given as "-name value"
+  int         type; // OPT_INT, OPT_DBL or OPT_KEY
+  const char *keys; // candidates of OPT_KEY separated by ','
+  void       *val;
+} Option;
+// The unit sputter yield and the work arrays to convolute it
+typedef struct ConvPlan
+{
+  int    mode;
+  int    n_tgt, n_uni, hn_uni, n_all;
+  double *unit;
+  // used in CONV_DIRECT
+  int    simd;
+  double *unit_rev; // unit in the reverse order
+  double *pad_buf;  // array padded with zeros, n_all+n_uni
+  void   (*correlate_row)(const double *u, int n_u, 
+            const double *x, double *y, int n_y);
+  // the same in single precision (PREC_SINGLE, PREC_MIXED)
+  int    single;    // VALID while the float kernels are used
+  int    mixed;     // VALID while PREC_MIXED runs in float
+  float  *unit_f, *unit_rev_f, *pad_f;
+  void   (*correlate_row_f)(const float *u, int n_u, 
+            const float *x, float *y, int n_y);
+  int    fixed;     // VALID with a kernel of FixedKernels.inc
+  int    n_blk;     // rows in a tile, N_ROWBLOCK at most
+  int    n_tap;     // taps of the unit in a tile
+  // used in CONV_FFT (complex numbers are stored as re, im)
+  //   and CONV_SEGMENT (n_fft is the length of a segment)
+  int    n_fft;     // length of the real transform
+  int    n_thr;     // threads with their own buffers (CONV_SEGMENT)
+  int    *bitrev;   // bit reversal of n_fft/2 indices
+  double *twiddle;  // exp(-2*pi*i*k/n_fft), k<n_fft/2
+  double *spc_uni;  // spectrum of the unit, n_fft/2+1
+  double *spc_buf;  // spectrum of an array , n_fft/2+1 (x n_thr)
+  double *real_buf; // real array of n_fft (x n_thr)
+  // used in the normal equation
+  double *autocor;  // (unit x unit) centered on n_uni-1
+  double *spc_nrm;  // power spectrum of the unit (CONV_FFT)
+  double *fig_mrg;  // figure in the margins out of the target
+  double *cor_mrg;  // its correlation near the both ends
+  struct ConvPlan *nrm; // CONV_DIRECT of autocor (CONV_DIRECT)
+  struct ConvPlan *mrg; // CONV_DIRECT of the unit for the margins
+  long   n_conv;    // convolutions and correlations computed
+  // used in the active set of the solver (CONV_DIRECT)
+  const char *act;  // VALID at the rows not to be correlated
+  long   n_skip;    // rows skipped
+} ConvPlan;
+#ifdef FIXED_KERNELS
+// A kernel written by GenerateKernels for a length of the unit
+typedef struct
+{
+  int    n_uni;
+  int    simd;
+  void   (*correlate_row)(const double *u, int n_u, 
+            const double *x, double *y, int n_y);
+} FixedKernel;
+#endif
+// The arrays and the parameters refreshed in the loop
+typedef struct
+{
+  int    n_tgt, n_uni, hn_uni, n_all;
+  double alpha, ls_alpha, mr_alpha, lim_alpha, offset_time;
+  double max_alpha;  // 1/L, the limit of enlarging alpha
+  int    n_grow;     // steps lessening the errors to enlarge alpha
+  int    n_acc;      // steps lessening the errors in a row
+  int    n_inc, n_dec; // times alpha is enlarged and lessened
+  double rms_bef, rms_aft;
+  double rms_rnd;    // rounding errors of the RMS in float
+  double *target, *real_fig, *error, *dwelltime, *update;
+  // used in the normal equation
+  int    normal_eq;
+  double sq_tgt;
+  double *cor_tgt;   // (unit x target)
+  double *normal;    // (unit x unit x dwelltime)
+  // used in the incremental figure
+  int    incr_fig;
+  int    n_step;     // accepted steps since the figure was computed
+  int    fresh;      // VALID when fig_upd belongs to the update
+  int    backtrack;  // VALID to discard the steps as in incr_fig
+  int    n_rej;      // steps discarded
+  int    stop;       // STOP_ALPHA when no shorter step is left
+  // used in the active set
+  int    n_act;      // samples in the active set
+  int    n_cor;      // correlations since the set was refreshed
+  char   *act;       // VALID at the samples in the active set
+  double rms_cur;    // RMS of the accepted dwell time
+  double *fig_upd;   // (unit * update)
+  double *clp_cor;   // correction of the steps cut by offset_time
+  double *fig_trl, *err_trl, *dwell_trl; // the trial step
+  // used in the line search
+  int    step_mode;
+  // used in STEP_BB
+  int    n_hst;      // accepted steps in sq_hst
+  double sq_hst[N_NONMONO]; // squared errors of the last steps
+  double *upd_trl;   // update of the trial step
+  // used in STEP_FISTA
+  int    restart, n_rst;
+  double t_mom;      // t of FISTA, 0 before the first step
+  double *dwell_prv, *fig_prv; // the previous dwell time
+  // used in STEP_CG
+  int    cg_rst;     // VALID to restart from the update
+  double sq_grd;     // |update|^2 on the free samples
+  double *dir, *fig_dir; // the conjugate direction, (unit * dir)
+  char   *fixed;     // VALID at the samples held at offset_time
+  // used in STEP_LBFGSB (with dir, fig_dir and fixed)
+  int    n_hist, n_pair; // pairs kept at most, and kept now
+  int    i_pair;     // where the next pair is kept
+  double *rho;       // 1/(s, y) of each pair
+  double *a_hst;     // coefficients of the two-loop recursion
+  double **s_hst, **y_hst; // differences of the dwell time, update
+  // used in STEP_RL and STEP_RLACC (with dwell_prv)
+  double *rl_nrm;    // (unit x 1) over the target
+  double *rl_stp;    // the last step of the multiplicative update
+  // used in the stopping criteria
+  double rel_tol, grd_tol;
+  int    n_chk;      // checks made
+  double rms_win[N_WINDOW]; // RMS at the last checks
+  double grd_ref;    // |gradient| at the first check
+  double grd_nrm, prj_nrm;  // |gradient| and its projection
+  double *grd_chk;   // the gradient at the check
+  // used in the circulant preconditioner
+  double pre_eps;
+  ConvPlan *pre;     // CONV_FFT of n_fft >= n_all
+  double *spc_pre;   // 1/(|FFT(unit)|^2 + pre_eps*L)/n_fft
+  double *pre_upd;   // the filtered update
+} Solver;
+// Read the command-line arguments
+int    ReadArguments(int argc, char *argv[], int n_opt,
+          Option *opt);
 // Initialize the number of data and all the arrays
 int    InitDisplay(int n_tgt, int n_uni, int hn_uni, int n_all,
           double init_st, double init_en, int nthreads);
@@ -119,10 +628,12 @@ int    InitFileNames(const char *fpth, char *time, char *fnm,
 int    ReadFilePaths(char *fpth_tgt, char *fpth_uni);
 int    InitInputNum(int *n_tgt, int *n_uni, int *n_all, 
           char *fpth_tgt, char *fpth_uni);
+int    TrimUnitTails(double trim_tail, int n_tgt, int *n_uni, 
+          int *uni_st, int *n_all, char *fpth_uni);
 int    ReadInputDat(double *target, int *n_tgt, 
-          double *unit, int *n_uni, double *dwelltime, 
-          const double offset_time, const double offset_hgt,
-          int *n_all, int *hn_uni, 
+          double *unit, int *n_uni, int uni_st, int trimmed, 
+          double *dwelltime, const double offset_time, 
+          const double offset_hgt, int *n_all, int *hn_uni, 
           char *fpth_tgt, char *fpth_uni);
 int    InitMatrixToDblZero(int ni, int nj, double **aa);
 int    InitVectorToDblZero(int ni, double *a);
@@ -144,6 +655,139 @@ int    WritePartAndHeader(int n_all, int n_tgt, int n_uni,
           int nj, char *filepath, 
           double **aa, char **bb, double *c);
 int    DisplaySumDwellTime(int n_all, double *dwelltime);
+// Calculate the errors and the update
+double CalcErrors(int n_tgt, int n_uni, double *target,
+          double *real_fig, double *error);
+double CalcNormalUpdate(int n_all, int n_tgt, int hn_uni, 
+          double sq_tgt, double *cor_tgt, double *normal, 
+          double *dwelltime, double *update);
+// Refresh the dwell time
+int    InitSolver(Solver *sol, ConvPlan *plan, int normal_eq,
+          int incr_fig, int backtrack, int step_mode, int restart, 
+          int n_hist, int n_grow, double alpha, double ls_alpha, 
+          double mr_alpha, double lim_alpha, double offset_time, 
+          double *target, double *real_fig, double *error, 
+          double *dwelltime, double *update);
+void   DeallocateSolver(Solver *sol);
+int    IterateDeconvolution(ConvPlan *plan, Solver *sol, int cnt);
+int    IterateLandweber(ConvPlan *plan, Solver *sol, int cnt);
+int    IterateIncremental(ConvPlan *plan, Solver *sol, int cnt);
+int    IterateBacktracking(ConvPlan *plan, Solver *sol, int cnt);
+int    ControlAlpha(ConvPlan *plan, Solver *sol, int accept, int cnt,
+          double rms);
+double RoundingRMS(ConvPlan *plan, Solver *sol);
+int    InitActiveSet(Solver *sol);
+int    BeginActiveSet(ConvPlan *plan, Solver *sol);
+int    EndActiveSet(ConvPlan *plan, Solver *sol, int refresh, 
+          double *update);
+int    IterateLineSearch(ConvPlan *plan, Solver *sol, int cnt);
+int    IterateBarzilaiBorwein(ConvPlan *plan, Solver *sol, int cnt);
+int    IterateFISTA(ConvPlan *plan, Solver *sol, int cnt);
+int    IterateConjugateGradient(ConvPlan *plan, Solver *sol, int cnt);
+int    IterateLBFGSB(ConvPlan *plan, Solver *sol, int cnt);
+int    IterateRichardsonLucy(ConvPlan *plan, Solver *sol, int cnt);
+int    InitStopping(ConvPlan *plan, Solver *sol, double rel_tol, 
+          double grd_tol);
+int    CheckConvergence(ConvPlan *plan, Solver *sol);
+int    DisplayStopReason(Solver *sol, int stop);
+int    InitPrecond(Solver *sol, ConvPlan *plan, double pre_eps);
+int    InitWienerFilter(Solver *sol, ConvPlan *plan, double eps);
+void   DeallocateWienerFilter(Solver *sol);
+int    InitWarmStart(ConvPlan *plan, Solver *sol, double wnr_eps);
+double ApplyPrecond(Solver *sol, double *src, double *dst);
+int    TakeProjectedStep(ConvPlan *plan, Solver *sol, double alpha, 
+          double *dir, double *fig_dir, int proj, double *beta);
+// Deconvolute the downsampled target in advance
+int    SolveMultigrid(ConvPlan *plan, Solver *sol, int n_level, 
+          double threshold, double rel_tol, double grd_tol);
+int    ProlongDwellTime(int n_uni_c, int n_all_c, double *dwell_c,
+          int n_uni, int hn_uni, int n_all, double offset_time, 
+          double *dwelltime);
+// Convolute the unit sputter yield with the arrays
+int    InitConvPlan(ConvPlan *plan, int mode, int simd, int prec,
+          int n_tgt, int n_uni, int hn_uni, int n_all, 
+          double *unit);
+int    ChooseConvMode(int simd, int prec, int n_tgt, int n_uni, 
+          int hn_uni, int n_all, double *unit);
+int    SwitchToDouble(ConvPlan *plan, const char *reason);
+int    DisplayConvPlan(ConvPlan *plan);
+void   DeallocateConvPlan(ConvPlan *plan);
+int    ConvoluteFigure(ConvPlan *plan, double *dwelltime,
+          double *real_fig);
+double ConvoluteErrors(ConvPlan *plan, double *dwelltime,
+          double *target, double *real_fig, double *error);
+int    CorrelateErrors(ConvPlan *plan, double *error,
+          double *update);
+int    CorrelateUpdate(ConvPlan *plan, double *error,
+          double alpha, double offset_time, double *dwelltime);
+int    ConvoluteDirect(ConvPlan *plan, double *dwelltime,
+          double *real_fig);
+int    CorrelateDirect(ConvPlan *plan, double *error,
+          double *update);
+int    ConvoluteScatter(ConvPlan *plan, double *dwelltime,
+          double *real_fig);
+int    CorrelateScatter(ConvPlan *plan, double *error,
+          double *update);
+int    ConvoluteFFT(ConvPlan *plan, double *dwelltime,
+          double *real_fig);
+int    ConvoluteSpectra(ConvPlan *plan, double *dwelltime);
+int    CorrelateFFT(ConvPlan *plan, double *error,
+          double *update);
+int    CorrelateSpectra(ConvPlan *plan, double *error);
+int    InitSegmentSize(ConvPlan *plan);
+int    ConvoluteSegments(ConvPlan *plan, double *dwelltime,
+          double *real_fig);
+int    CorrelateSegments(ConvPlan *plan, double *error,
+          double *update);
+int    SegmentConvolution(ConvPlan *plan, const double *spc, 
+          int n_k, int hn_k, int type, const double *src, 
+          int x_off, int n_src, double *y, int y_lo, int y_hi);
+int    InitNormalPlan(ConvPlan *plan);
+int    ApplyNormal(ConvPlan *plan, double *dwelltime,
+          double *normal);
+int    NormalDirect(ConvPlan *plan, double *dwelltime,
+          double *normal);
+int    NormalFFT(ConvPlan *plan, double *dwelltime,
+          double *normal);
+int    NormalSegments(ConvPlan *plan, double *dwelltime,
+          double *normal);
+int    SubtractMargins(ConvPlan *plan, double *dwelltime,
+          double *normal);
+// Vectorized kernels, y[k] = sum_j u[j]*x[k+j] (k<n_y, j<n_u)
+int    DetectSIMD(void);
+int    InitTileSize(ConvPlan *plan);
+void   PadArray(ConvPlan *plan, const double *src, int off, int n);
+void   CorrelateTile(ConvPlan *plan, int rev, int k, 
+          double *y, int n_y);
+int    CorrelateRows(ConvPlan *plan, int rev, int k, 
+          double *y, int n_y);
+int    CorrelateFreeRows(ConvPlan *plan, int k, double *y, int n_y);
+void   CorrelateRowGeneric(const double *u, int n_u, 
+          const double *x, double *y, int n_y);
+#ifdef SIMD_X86
+void   CorrelateRowSSE2(const double *u, int n_u, 
+          const double *x, double *y, int n_y);
+void   CorrelateRowAVX2(const double *u, int n_u, 
+          const double *x, double *y, int n_y);
+void   CorrelateRowAVX512(const double *u, int n_u, 
+          const double *x, double *y, int n_y);
+#endif
+void   CorrelateRowGenericF(const float *u, int n_u, 
+          const float *x, float *y, int n_y);
+#ifdef SIMD_X86
+void   CorrelateRowSSE2F(const float *u, int n_u, 
+          const float *x, float *y, int n_y);
+void   CorrelateRowAVX2F(const float *u, int n_u, 
+          const float *x, float *y, int n_y);
+void   CorrelateRowAVX512F(const float *u, int n_u, 
+          const float *x, float *y, int n_y);
+#endif
+// Fast Fourier transform of real arrays
+void   TransformComplexFFT(int n, double *z,
+          const int *bitrev, const double *twiddle, int stride,
+          int inverse);
+void   TransformRealFFT(ConvPlan *plan, double *x, double *spc);
+void   InverseRealFFT(ConvPlan *plan, double *spc, double *x);
 // Allocate & deallocate matrix
 void   **AllocateMatrix(int size, int m, int n);
 void   DeallocateMatrix(double **aa           );
@@ -154,6 +798,9 @@ void   DeallocateVector(double *a             );
 double GetElapsedTime();
 double GetCPUTime();
 int    GetCurrentTime(char *str);
+#ifdef FIXED_KERNELS
+#include "FixedKernels.inc"
+#endif
 
 int main (int argc, char *argv[])
 {
@@ -162,11 +809,28 @@ int main (int argc, char *argv[])
   **************************************************************/
   double       alpha     = 10.5;
   const double ls_alpha  = 0.95;
-  //const double mr_alpha  = 1.05;
+  double       mr_alpha  = 1.0;
   const double lim_alpha = 0.5E-6;
   double       threshold = 0.1;
+  double       rel_tol   = 1E-6;
+  double       grd_tol   = 0.0;
   const double offset_time = 1500.0; // in ms
   const double offset_hgt = 200.0; 
+  int          conv_mode = CONV_AUTO;
+  int          normal_eq = INVALID;
+  int          simd_mode = SIMD_AUTO;
+  int          incr_fig  = INVALID;
+  int          backtrack = INVALID;
+  int          active_set = INVALID;
+  int          prec_mode = PREC_DOUBLE;
+  double       trim_tail = 0.0;
+  int          step_mode = STEP_SHRINK;
+  int          restart_mode = RESTART_FUNC;
+  int          n_hist    = 10;
+  int          n_level   = 1;
+  int          n_grow    = 50;
+  double       pre_eps   = 0.0;
+  double       wnr_eps   = 0.0;
   /**************************************************************
     Some useful arguments (change them where necessary)
   **************************************************************/
@@ -184,26 +848,57 @@ int main (int argc, char *argv[])
   char       outfilenm_tm [BUFF_SIZE]="dwelltimes.txt";
   char       time         [BUFF_SIZE]="";
   char       ctmp         [BUFF_SIZE-10]="";
-  int    n_tgt=0, n_uni=0, n_all, hn_uni; 
+  int    n_tgt=0, n_uni=0, n_all, hn_uni, uni_st=0; 
   //int    n_buff0, n_buffN;
-  int    cnt, cnt_rec, i, j, tmp;
-  int    s_cnt, e_cnt;
+  int    cnt, cnt_rec, i, stop;
   int    nthreads;
-  double rms_bef = 10E7, rms_aft = 10E7;
   double figerr_max = 0.0, figerr_min = 0.0;
   double st, en, st_omp, en_omp,  init_st, init_en;
+  Option options[] =
+  {
+    {"conv",   OPT_KEY, "direct,fft,scatter,auto,segment", 
+      &conv_mode},
+    {"normal", OPT_KEY, "on,off",             &normal_eq},
+    {"simd",   OPT_KEY, "auto,generic,sse2,avx2,avx512", 
+      &simd_mode},
+    {"incr",   OPT_KEY, "on,off",             &incr_fig },
+    {"backtrack", OPT_KEY, "on,off",          &backtrack},
+    {"active", OPT_KEY, "on,off",             &active_set},
+    {"grow",   OPT_DBL, NULL,                 &mr_alpha },
+    {"streak", OPT_INT, NULL,                 &n_grow   },
+    {"prec",   OPT_KEY, "double,single,mixed", &prec_mode},
+    {"trim",   OPT_DBL, NULL,                 &trim_tail},
+    {"step",   OPT_KEY, 
+      "shrink,exact,projected,bb,fista,cg,lbfgsb,rl,rlacc", 
+      &step_mode},
+    {"restart",OPT_KEY, "func,grad",          &restart_mode},
+    {"hist",   OPT_INT, NULL,                 &n_hist   },
+    {"levels", OPT_INT, NULL,                 &n_level  },
+    {"precond",OPT_DBL, NULL,                 &pre_eps  },
+    {"warm",   OPT_DBL, NULL,                 &wnr_eps  },
+    {"threshold", OPT_DBL, NULL,              &threshold},
+    {"rtol",   OPT_DBL, NULL,                 &rel_tol  },
+    {"gtol",   OPT_DBL, NULL,                 &grd_tol  },
+  };
   /**************************************************************
     Arrays to deconvolute the input data
    **************************************************************/
   double *target,*real_fig,*error,*dwelltime,*update,*unit,*info;
   double **memory,**fig_hst,**err_hst,**tm_hst;
   char   **columns,**hst_info;
+  ConvPlan plan;
+  Solver   sol;
   /**************************************************************
     Initialize the filename, the arrays and the parameters
   **************************************************************/
   st = GetCPUTime();
   st_omp = omp_get_wtime();
   init_st = GetCPUTime();
+  if (ReadArguments(argc, argv, 
+        sizeof(options)/sizeof(Option), options) != VALID)
+  {
+    exit(1);
+  }
   // initialize filenames
   if (addtime == VALID)
   {
@@ -224,6 +919,14 @@ int main (int argc, char *argv[])
   InitFileNames (outfilepath,time,outfilenm_tm ,outfilenm_tm );
   InitInputNum  (&n_tgt, &n_uni, &n_all, 
     infilepth_tgt, infilepth_uni);
+  if (trim_tail > 0.0)
+  {
+    if (TrimUnitTails(trim_tail, n_tgt, &n_uni, &uni_st, &n_all, 
+          infilepth_uni) != VALID)
+    {
+      exit(1);
+    }
+  }
   // allocate and initialize the arrays
   target    = (double*) AllocateVector(sizeof(double), n_tgt );
   real_fig  = (double*) AllocateVector(sizeof(double), n_all );
@@ -255,9 +958,41 @@ int main (int argc, char *argv[])
   InitMatrixToDblZero(n_all, 2 +  N_LOOPMAX / N_LOOPREC, fig_hst);
   InitMatrixToDblZero(n_tgt, 2 +  N_LOOPMAX / N_LOOPREC, err_hst);
   InitMatrixToDblZero(n_all, 2 +  N_LOOPMAX / N_LOOPREC,  tm_hst);
-  ReadInputDat(target, &n_tgt, unit, &n_uni, dwelltime, 
-      offset_time, offset_hgt, &n_all, &hn_uni, 
-      infilepth_tgt, infilepth_uni);
+  if (ReadInputDat(target, &n_tgt, unit, &n_uni, uni_st, 
+        (trim_tail > 0.0) ? VALID : INVALID, dwelltime, 
+        offset_time, offset_hgt, &n_all, &hn_uni, 
+        infilepth_tgt, infilepth_uni) != VALID)
+  {
+    exit(1);
+  }
+  InitConvPlan(&plan, conv_mode, simd_mode, prec_mode, 
+      n_tgt, n_uni, hn_uni, n_all, unit);
+  DisplayConvPlan(&plan);
+  InitSolver(&sol, &plan, normal_eq, incr_fig, backtrack, 
+      step_mode, restart_mode, n_hist, n_grow, alpha, ls_alpha, 
+      mr_alpha, lim_alpha, offset_time, target, real_fig, error, 
+      dwelltime, update);
+  if (wnr_eps > 0.0 && n_level > 1)
+  {
+    printf("wnr_eps is ignored with n_level.\n");
+  }
+  else if (wnr_eps > 0.0)
+  {
+    InitWarmStart(&plan, &sol, wnr_eps);
+  }
+  if (pre_eps > 0.0)
+  {
+    InitPrecond(&sol, &plan, pre_eps);
+  }
+  if (n_level > 1)
+  {
+    SolveMultigrid(&plan, &sol, n_level, threshold, rel_tol, grd_tol);
+  }
+  if (active_set == VALID)
+  {
+    InitActiveSet(&sol);
+  }
+  InitStopping(&plan, &sol, rel_tol, grd_tol);
   init_en = GetCPUTime();
   nthreads = omp_get_max_threads();
   // display the initial conditions
@@ -266,16 +1001,21 @@ int main (int argc, char *argv[])
     Calculate the dwell time in the loop
   **************************************************************/
   cnt = 0; cnt_rec = 0;
-  s_cnt = hn_uni; e_cnt = n_all-hn_uni;
-  while (rms_bef > threshold)
+  stop = STOP_THRESHOLD;
+  while (sol.rms_bef > threshold)
   {
     cnt++;
     // memorize the history of arrays
     if ( (cnt % (int)N_LOOPREC == 0) || cnt == 1)
     {
-      MemorizeData(n_all, cnt_rec, real_fig , fig_hst);
-      MemorizeData(n_tgt, cnt_rec,    error , err_hst);
-      MemorizeData(n_all, cnt_rec, dwelltime,  tm_hst);
+      if (sol.normal_eq == VALID)
+      {
+        ConvoluteErrors(&plan, sol.dwelltime, target, 
+            sol.real_fig, sol.error);
+      }
+      MemorizeData(n_all, cnt_rec, sol.real_fig , fig_hst);
+      MemorizeData(n_tgt, cnt_rec,    sol.error , err_hst);
+      MemorizeData(n_all, cnt_rec, sol.dwelltime,  tm_hst);
       sprintf(hst_info[cnt_rec], "Iteration-%d", cnt);
       cnt_rec++;
       printf("Have memorized arrays %d times\n", cnt_rec);
@@ -284,92 +1024,54 @@ int main (int argc, char *argv[])
     if (cnt > N_LOOPMAX)
     {
       printf("Reached the maximum number of loops\n");
+      stop = STOP_LOOPMAX;
       break;
     }
     // display the current parameters
     if (cnt % (int)N_LOOPDISP == 0)
     {
-      printf("loop: %9d, alpha: %9.4lf, rms: %9.4lf\n",
-          cnt, alpha, rms_aft);
+      printf("loop: %9d, alpha: %9.4lf, rms: %9.4lf, "
+          "time: %9.4lf sec.", cnt, sol.alpha, sol.rms_aft,
+          omp_get_wtime()-st_omp);
+      if (sol.act != NULL) printf(" active: %d", sol.n_act);
+      printf("\n");
     } 
-    // intialize the arrays
-#pragma omp parallel for default(none) \
-    private(i)                         \
-    shared(n_all,real_fig,update)
-    for (i=0; i<n_all; i++)
-    {
-      real_fig[i] = 0.0;
-      update[i] = 0.0;
-    }
-    // convolute the unit sputter yield with the dwell time
-#pragma omp parallel for default(none) \
-    private(i,j,tmp)\
-    shared(s_cnt, e_cnt, n_uni,hn_uni,dwelltime,unit)\
-    reduction(+:real_fig[:n_all])
-    for (i=s_cnt; i<e_cnt; i++)
-    {
-      for (j=0; j<n_uni; j++)
-      {
-        tmp            = i - hn_uni + j;
-        real_fig[tmp] += (dwelltime[i]*unit[j]);
-      }
-    }
-    // calculate the errors between the target and the figure
-    rms_bef = rms_aft;  
-    rms_aft = 0.0;
-#pragma omp parallel for default(none)       \
-    private(i,tmp)                           \
-    shared(n_tgt,n_uni,error,target,real_fig)\
-    reduction(+:rms_aft)
-    for (i=0; i<n_tgt; i++)
+    // refine the dwell time in double precision near the threshold
+    if (sol.rms_aft < MIXED_RMS*threshold)
     {
-      tmp      = i + n_uni;
-      error[i] = 0.0;
-      error[i] = target[i] - real_fig[tmp];
-      rms_aft += (error[i]*error[i]);
+      SwitchToDouble(&plan, "threshold");
     }
-    rms_aft = sqrt( rms_aft/n_tgt );
-    // lessen alpha if the current errors worsen
-    if (rms_bef < rms_aft)
+    IterateDeconvolution(&plan, &sol, cnt);
+    if (sol.stop != STOP_NONE)
     {
-      if (alpha*ls_alpha > lim_alpha)
-      {
-        alpha *= ls_alpha;
-        printf("Multiplied alpha by %9.4lf\n", ls_alpha);
-        printf("loop: %9d, alpha: %9.4lf, rms: %9.4lf\n",
-            cnt, alpha, rms_aft);
-      }
+      stop = sol.stop;
+      break;
     }
-    else
+    // stop when the errors or the gradient no longer change, 
+    //   but refine the dwell time in double first with PREC_MIXED
+    if (cnt % (int)N_LOOPCHECK == 0 
+        && (stop = CheckConvergence(&plan, &sol)) != STOP_NONE)
     {
-      // calculate the evaluation function (err x unit)
-#pragma omp parallel for default(none) \
-      private(i,j,tmp)\
-      shared(n_tgt, n_uni, hn_uni,error,unit)\
-      reduction(+:update[:n_all])
-      for (i=0; i<n_tgt; i++)
-      {
-        for (j=0; j<n_uni; j++)
-        {
-          tmp = i + n_uni - hn_uni + j;
-          update[tmp] += (error[i]*unit[j]); // why?
-        }
-      }
-      // refresh the dwelltime using (t=t-alpha × (p-f))
-#pragma omp parallel for default(none)       \
-      private(i)                           \
-      shared(s_cnt,e_cnt,alpha,update,dwelltime)
-      for (i=s_cnt; i<e_cnt; i++)
-      {
-        dwelltime[i] += (alpha*update[i]);
-        // limit the minimum dwell time
-        if (dwelltime[i] < offset_time)
-        {
-          dwelltime[i] = offset_time;
-        }
-      }
+      if (SwitchToDouble(&plan, "stalled") != VALID) break;
+      sol.n_chk = 1;
     }
+    stop = STOP_THRESHOLD;
+  }
+  // the final figure is always computed in double precision
+  if (sol.normal_eq == VALID || sol.incr_fig == VALID 
+      || sol.backtrack == VALID || sol.step_mode != STEP_SHRINK 
+      || plan.single == VALID)
+  {
+    plan.single = INVALID;
+    plan.mixed  = INVALID;
+    sol.rms_aft = ConvoluteErrors(&plan, sol.dwelltime, target, 
+        sol.real_fig, sol.error);
   }
+  // the arrays may have been exchanged with those of the trial step
+  real_fig  = sol.real_fig;
+  error     = sol.error;
+  dwelltime = sol.dwelltime;
+  update    = sol.update;
   for (i=0; i<n_tgt; i++)
   {
     if (figerr_max < error[i]) figerr_max = error[i];
@@ -380,14 +1082,36 @@ int main (int argc, char *argv[])
 **************************************************************/
   printf("\nDone.\n");
   printf("loop: %9d, alpha: %9.4lf, \nrms: %9.4lf, PV: %9.4lf\n",
-      cnt, alpha, rms_aft, figerr_max-figerr_min);
+      cnt, sol.alpha, sol.rms_aft, figerr_max-figerr_min);
   DisplaySumDwellTime(n_all, dwelltime);
+  printf("Convolutions: %ld, ", plan.n_conv);
+  if (sol.step_mode == STEP_FISTA || sol.step_mode == STEP_CG
+      || sol.step_mode == STEP_RLACC)
+  {
+    printf("restarts: %d, ", sol.n_rst);
+  }
+  if (sol.incr_fig == VALID || sol.backtrack == VALID)
+  {
+    printf("rejected steps: %d of %d, ", sol.n_rej, 
+        sol.n_rej+sol.n_step);
+  }
+  if (sol.step_mode == STEP_SHRINK)
+  {
+    printf("alpha enlarged: %d, lessened: %d, ", sol.n_inc, sol.n_dec);
+  }
+  if (sol.act != NULL)
+  {
+    printf("active: %d of %d samples, rows skipped: %ld, ", 
+        sol.n_act, n_all-2*hn_uni, plan.n_skip);
+  }
+  printf("wall time: %9.4lf sec.\n", omp_get_wtime()-st_omp);
+  DisplayStopReason(&sol, stop);
   MemorizeData(n_all, cnt_rec, real_fig , fig_hst);
   MemorizeData(n_tgt, cnt_rec,    error , err_hst);
   MemorizeData(n_all, cnt_rec, dwelltime,  tm_hst);
   sprintf(hst_info[cnt_rec], "Iteration-%d", cnt);
   cnt_rec++;
-  RecordInfo(rms_aft, n_tgt, n_uni, n_all, info);
+  RecordInfo(sol.rms_aft, n_tgt, n_uni, n_all, info);
   RecordColumns(columns);
   RecordAllArrDat(n_tgt, n_uni, n_all, 
       memory, target, error, dwelltime, real_fig, unit);
@@ -417,6 +1141,8 @@ int main (int argc, char *argv[])
   DeallocateMatrix( tm_hst    );
   DeallocateMatStr( columns   );
   DeallocateMatStr( hst_info  );
+  DeallocateConvPlan( &plan   );
+  DeallocateSolver  ( &sol    );
   en = GetCPUTime();
   en_omp = omp_get_wtime();
   printf("Serial Computation time: %9.4lf sec.\n", en-st);
@@ -472,6 +1198,67 @@ int ReadFilePaths(char *fpth_tgt, char *fpth_uni)
   scanf("%s", fpth_uni);
   return 0;
 }
+int ReadArguments(int argc, char *argv[], int n_opt, Option *opt)
+{
+  int  i, k, n, found;
+  char key[BUFF_SIZE];
+  const char *p, *q;
+  for (i=1; i<argc; i++)
+  {
+    found = INVALID;
+    for (k=0; k<n_opt; k++)
+    {
+      if (argv[i][0] != '-' || strcmp(argv[i]+1, opt[k].name) != 0)
+      {
+        continue;
+      }
+      if (i+1 >= argc)
+      {
+        printf("No value is given for %s.\n", argv[i]);
+        return -1;
+      }
+      i++;
+      found = VALID;
+      if (opt[k].type == OPT_INT)
+      {
+        *(int*)opt[k].val = atoi(argv[i]);
+      }
+      else if (opt[k].type == OPT_DBL)
+      {
+        *(double*)opt[k].val = atof(argv[i]);
+      }
+      else
+      {
+        // find the position of the value in the candidates
+        found = INVALID;
+        for (p=opt[k].keys, n=0; found != VALID; p=q+1, n++)
+        {
+          q = strchr(p, ',');
+          if (q == NULL) q = p + strlen(p);
+          sprintf(key, "%.*s", (int)(q-p), p);
+          if (strcmp(key, argv[i]) == 0)
+          {
+            *(int*)opt[k].val = n;
+            found = VALID;
+          }
+          if (*q == '\0') break;
+        }
+        if (found != VALID)
+        {
+          printf("Choose %s from %s.\n", argv[i-1], opt[k].keys);
+          return -1;
+        }
+      }
+      break;
+    }
+    if (found != VALID)
+    {
+      printf("Unknown argument: %s\n", argv[i]);
+      return -1;
+    }
+  }
+  return 0;
+}
 int InitInputNum(int* n_tgt, int* n_uni, int* n_all, 
     char* fpth_tgt, char* fpth_uni)
 {
@@ -509,9 +1296,64 @@ int InitInputNum(int* n_tgt, int* n_uni, int* n_all,
   return 0;
 }
 // read the input files and intialize the arrays
+// keep the unit within [uni_st, uni_st+n_uni) centered on the center 
+//   of the file, cutting off the tails below trim_tail of the energy
+int TrimUnitTails(double trim_tail, int n_tgt, int *n_uni, 
+    int *uni_st, int *n_all, char *fpth_uni)
+{
+  int    i, h, c, n_odd, cnt = 0;
+  double sq = 0.0, sq_in, sum = 0.0, sum_in = 0.0;
+  double *unit;
+  FILE   *fp;
+  char   buf[BUFF_SIZE];
+  if ( (fp = fopen(fpth_uni, "r")) == NULL )
+  {
+    printf("Couldn't find a file for the unit sputter yield.\n");
+    return -1;
+  }
+  unit = (double*)AllocateVector(sizeof(double), *n_uni);
+  while ( fgets(buf, BUFF_SIZE, fp) != NULL && cnt < (*n_uni))
+  {
+    sscanf(buf, "%lf", &unit[cnt]);
+    cnt++;
+  }
+  fclose(fp);
+  // the last element is removed as in ReadInputDat if n_uni is even
+  n_odd = cnt - (1 - cnt%2);
+  c     = (n_odd-1) / 2;
+  for (i=0; i<n_odd; i++)
+  {
+    sq  += unit[i]*unit[i];
+    sum += fabs(unit[i]);
+  }
+  // widen the half width h until the tails hold little energy
+  sq_in = unit[c]*unit[c];
+  for (h=0; h<c && sq-sq_in > trim_tail*sq; )
+  {
+    h++;
+    sq_in += unit[c-h]*unit[c-h] + unit[c+h]*unit[c+h];
+  }
+  (*uni_st) = c - h;
+  (*n_uni)  = 2*h + 1;
+  (*n_all)  = n_tgt + 2*N_MARGIN*(*n_uni);
+  // sum up the tails themselves to avoid the cancellation
+  sq_in = 0.0;
+  for (i=0; i<n_odd; i++)
+  {
+    if (i >= c-h && i <= c+h) continue;
+    sq_in  += unit[i]*unit[i];
+    sum_in += fabs(unit[i]);
+  }
+  printf("Trimmed the unit sputter yield from %d to %d entries\n", 
+      n_odd, *n_uni);
+  printf("  energy cut off: %e, volume cut off: %e\n", 
+      (sq > 0.0) ? sq_in/sq : 0.0, (sum > 0.0) ? sum_in/sum : 0.0);
+  DeallocateVector( unit );
+  return 0;
+}
 int ReadInputDat(double* target, int* n_tgt, 
-    double* unit, int* n_uni, double* dwelltime, 
-    const double offset_time, const double offset_hgt,
+    double* unit, int* n_uni, int uni_st, int trimmed, 
+    double* dwelltime, const double offset_time, const double offset_hgt,
     int* n_all, int* hn_uni, 
     char* fpth_tgt, char* fpth_uni)
 {
@@ -545,10 +1387,15 @@ int ReadInputDat(double* target, int* n_tgt,
   cnt = 0;
   while ( fgets(buf, BUFF_SIZE, fp) != NULL)
   {
-    sscanf(buf, "%lf", &unit[cnt]);
+    // skip the tails trimmed in advance
+    if (cnt >= uni_st && cnt < uni_st+(*n_uni))
+    {
+      sscanf(buf, "%lf", &unit[cnt-uni_st]);
+    }
     cnt++;
   }
-  if ( (*n_uni) != cnt) 
+  // the whole file is read unless trimmed in advance
+  if ( (trimmed != VALID && (*n_uni) != cnt) || cnt < uni_st+(*n_uni) ) 
   {
     printf("Inappropriate BUFF_SIZE for %s.\n", fpth_uni); 
     return -1;
@@ -561,7 +1408,7 @@ int ReadInputDat(double* target, int* n_tgt,
   // intialize the arrays for recording dwell time
 #pragma omp parallel for default(none) \
   private(i)                           \
-  shared(n_all, hn_uni, dwelltime)     
+  shared(n_all, hn_uni, offset_time, dwelltime)
   for (i=(*hn_uni); i<(*n_all)-(*hn_uni); i++)
   {
     dwelltime[i] = offset_time;
@@ -779,6 +1626,47 @@ int WritePartAndHeader(int n_all, int n_tgt, int n_uni, int nj,
   }
   fclose(fp);
   return 0;
+}
+  /**************************************************************
+     Calculate the errors and the update
+  **************************************************************/
+// error = target - real_fig within the target, returning the RMS
+double CalcErrors(int n_tgt, int n_uni, double *target, 
+    double *real_fig, double *error)
+{
+  int    i;
+  double rms = 0.0;
+#pragma omp parallel for default(none)       \
+  private(i)                                 \
+  shared(n_tgt,n_uni,error,target,real_fig)  \
+  reduction(+:rms)
+  for (i=0; i<n_tgt; i++)
+  {
+    error[i] = target[i] - real_fig[i+n_uni];
+    rms     += (error[i]*error[i]);
+  }
+  return sqrt( rms/n_tgt );
+}
+// update = (unit x target) - (unit x unit x dwelltime), 
+//   returning the RMS from |error|^2 = |target|^2 
+//   - (dwelltime, unit x target) - (dwelltime, update)
+double CalcNormalUpdate(int n_all, int n_tgt, int hn_uni, 
+    double sq_tgt, double *cor_tgt, double *normal, 
+    double *dwelltime, double *update)
+{
+  int    i;
+  double sq = 0.0;
+#pragma omp parallel for default(none)          \
+  private(i)                                    \
+  shared(n_all,hn_uni,cor_tgt,normal,dwelltime,update) \
+  reduction(+:sq)
+  for (i=hn_uni; i<n_all-hn_uni; i++)
+  {
+    update[i] = cor_tgt[i] - normal[i];
+    sq       += dwelltime[i]*(cor_tgt[i] + update[i]);
+  }
+  sq = sq_tgt - sq;
+  return (sq > 0.0) ? sqrt( sq/n_tgt ) : 0.0;
 }
 int DisplaySumDwellTime(int n_all, double *dwelltime)
 {
@@ -795,6 +1683,2903 @@ int DisplaySumDwellTime(int n_all, double *dwelltime)
   printf("Total fabrication time: %9.4lf minutes\n"
       , sum/MS_TO_MIN);
   return 0;
+}
+  /**************************************************************
+     Refresh the dwell time
+  **************************************************************/
+int InitSolver(Solver *sol, ConvPlan *plan, int normal_eq,
+    int incr_fig, int backtrack, int step_mode, int restart, 
+    int n_hist, int n_grow, double alpha, double ls_alpha, 
+    double mr_alpha, double lim_alpha, double offset_time, 
+    double *target, double *real_fig, double *error, 
+    double *dwelltime, double *update)
+{
+  int i;
+  int n_tgt = plan->n_tgt, n_all = plan->n_all;
+  sol->n_tgt       = n_tgt;
+  sol->n_uni       = plan->n_uni;
+  sol->hn_uni      = plan->hn_uni;
+  sol->n_all       = n_all;
+  sol->alpha       = alpha;
+  sol->ls_alpha    = ls_alpha;
+  sol->mr_alpha    = mr_alpha;
+  sol->n_grow      = (n_grow > 0) ? n_grow : 1;
+  sol->n_acc       = 0;
+  sol->n_inc       = 0;
+  sol->n_dec       = 0;
+  sol->lim_alpha   = lim_alpha;
+  // 1/L, where |unit * a| <= (sum of |unit|)*|a|
+  sol->max_alpha   = 0.0;
+  for (i=0; i<plan->n_uni; i++) sol->max_alpha += fabs(plan->unit[i]);
+  sol->max_alpha   = 1.0/(sol->max_alpha*sol->max_alpha);
+  sol->offset_time = offset_time;
+  sol->rms_bef     = 10E7;
+  sol->rms_aft     = 10E7;
+  sol->target      = target;
+  sol->real_fig    = real_fig;
+  sol->error       = error;
+  sol->dwelltime   = dwelltime;
+  sol->update      = update;
+  sol->normal_eq   = normal_eq;
+  sol->incr_fig    = incr_fig;
+  sol->sq_tgt      = 0.0;
+  sol->rms_rnd     = 0.0;
+  for (i=0; i<n_tgt; i++) sol->rms_rnd += target[i]*target[i];
+  sol->rms_rnd     = ROUND_SINGLE*sqrt(sol->rms_rnd/n_tgt);
+  sol->cor_tgt     = NULL;
+  sol->normal      = NULL;
+  sol->n_step      = 0;
+  sol->fresh       = INVALID;
+  sol->backtrack   = backtrack;
+  sol->n_rej       = 0;
+  sol->stop        = STOP_NONE;
+  sol->n_act       = 0;
+  sol->n_cor       = 0;
+  sol->act         = NULL;
+  sol->rms_cur     = 10E7;
+  sol->fig_upd     = NULL;
+  sol->clp_cor     = NULL;
+  sol->fig_trl     = NULL;
+  sol->err_trl     = NULL;
+  sol->dwell_trl   = NULL;
+  sol->step_mode   = step_mode;
+  sol->n_hst       = 0;
+  sol->upd_trl     = NULL;
+  sol->restart     = restart;
+  sol->n_rst       = 0;
+  sol->t_mom       = 0.0;
+  sol->dwell_prv   = NULL;
+  sol->fig_prv     = NULL;
+  sol->cg_rst      = VALID;
+  sol->sq_grd      = 0.0;
+  sol->dir         = NULL;
+  sol->fig_dir     = NULL;
+  sol->fixed       = NULL;
+  sol->n_hist      = (n_hist > 0) ? n_hist : 1;
+  sol->n_pair      = 0;
+  sol->i_pair      = 0;
+  sol->rho         = NULL;
+  sol->a_hst       = NULL;
+  sol->pre_eps     = 0.0;
+  sol->pre         = NULL;
+  sol->spc_pre     = NULL;
+  sol->pre_upd     = NULL;
+  sol->s_hst       = NULL;
+  sol->y_hst       = NULL;
+  sol->rl_nrm      = NULL;
+  sol->rl_stp      = NULL;
+  sol->rel_tol     = 0.0;
+  sol->grd_tol     = 0.0;
+  sol->n_chk       = 0;
+  sol->grd_ref     = 0.0;
+  sol->grd_nrm     = 0.0;
+  sol->prj_nrm     = 0.0;
+  sol->grd_chk     = NULL;
+  if (step_mode != STEP_SHRINK 
+      && (normal_eq == VALID || incr_fig == VALID))
+  {
+    printf("normal_eq and incr_fig are ignored with step_mode.\n");
+    sol->normal_eq = normal_eq = INVALID;
+    sol->incr_fig  = incr_fig  = INVALID;
+  }
+  if (backtrack == VALID 
+      && (incr_fig == VALID || step_mode != STEP_SHRINK))
+  {
+    printf("backtrack is ignored with incr_fig and step_mode.\n");
+    sol->backtrack = backtrack = INVALID;
+  }
+  if (backtrack == VALID && normal_eq == VALID)
+  {
+    printf("normal_eq is ignored with backtrack.\n");
+    sol->normal_eq = normal_eq = INVALID;
+  }
+  if (incr_fig == VALID || backtrack == VALID 
+      || step_mode != STEP_SHRINK)
+  {
+    if (normal_eq == VALID)
+    {
+      printf("normal_eq is ignored with incr_fig.\n");
+      sol->normal_eq = INVALID;
+    }
+    sol->fig_upd   = (double*)AllocateVector(sizeof(double), n_all);
+    sol->clp_cor   = (double*)AllocateVector(sizeof(double), n_all);
+    sol->fig_trl   = (double*)AllocateVector(sizeof(double), n_all);
+    sol->err_trl   = (double*)AllocateVector(sizeof(double), n_tgt);
+    sol->dwell_trl = (double*)AllocateVector(sizeof(double), n_all);
+    if (step_mode == STEP_BB)
+    {
+      sol->upd_trl = (double*)AllocateVector(sizeof(double), n_all);
+    }
+    if (step_mode == STEP_FISTA)
+    {
+      sol->alpha = sol->max_alpha;
+      sol->dwell_prv = (double*)AllocateVector(sizeof(double), n_all);
+      sol->fig_prv   = (double*)AllocateVector(sizeof(double), n_all);
+    }
+    if (step_mode == STEP_LBFGSB)
+    {
+      sol->rho   = (double*) AllocateVector(sizeof(double), 
+          sol->n_hist);
+      sol->a_hst = (double*) AllocateVector(sizeof(double), 
+          sol->n_hist);
+      sol->s_hst = (double**)AllocateMatrix(sizeof(double), 
+          sol->n_hist, n_all);
+      sol->y_hst = (double**)AllocateMatrix(sizeof(double), 
+          sol->n_hist, n_all);
+    }
+    if (step_mode == STEP_RL || step_mode == STEP_RLACC)
+    {
+      sol->alpha  = 1.0;
+      sol->rl_nrm = (double*)AllocateVector(sizeof(double), n_all);
+    }
+    if (step_mode == STEP_RLACC)
+    {
+      sol->dwell_prv = (double*)AllocateVector(sizeof(double), n_all);
+      sol->rl_stp    = (double*)AllocateVector(sizeof(double), n_all);
+    }
+    if (step_mode == STEP_CG || step_mode == STEP_LBFGSB)
+    {
+      sol->dir     = (double*)AllocateVector(sizeof(double), n_all);
+      sol->fig_dir = (double*)AllocateVector(sizeof(double), n_all);
+      sol->fixed   = (char*)  AllocateVector(sizeof(char),   n_all);
+      for (i=0; i<n_all; i++) sol->fixed[i] = INVALID;
+    }
+  }
+  else if (normal_eq == VALID)
+  {
+    // correlate the target with the unit in advance
+    sol->cor_tgt = (double*)AllocateVector(sizeof(double), n_all);
+    sol->normal  = (double*)AllocateVector(sizeof(double), n_all);
+    InitNormalPlan(plan);
+    CorrelateErrors(plan, target, sol->cor_tgt);
+    for (i=0; i<n_tgt; i++) sol->sq_tgt += target[i]*target[i];
+  }
+  return 0;
+}
+void DeallocateSolver(Solver *sol)
+{
+  if (sol->cor_tgt != NULL)
+  {
+    DeallocateVector( sol->cor_tgt );
+    DeallocateVector( sol->normal  );
+  }
+  if (sol->fig_upd != NULL)
+  {
+    DeallocateVector( sol->fig_upd   );
+    DeallocateVector( sol->clp_cor   );
+    DeallocateVector( sol->fig_trl   );
+    DeallocateVector( sol->err_trl   );
+    DeallocateVector( sol->dwell_trl );
+  }
+  if (sol->upd_trl != NULL) DeallocateVector( sol->upd_trl );
+  if (sol->dwell_prv != NULL) DeallocateVector( sol->dwell_prv );
+  if (sol->fig_prv   != NULL) DeallocateVector( sol->fig_prv   );
+  if (sol->rl_nrm    != NULL) DeallocateVector( sol->rl_nrm    );
+  if (sol->rl_stp    != NULL) DeallocateVector( sol->rl_stp    );
+  if (sol->grd_chk   != NULL) DeallocateVector( sol->grd_chk   );
+  if (sol->act       != NULL) free( sol->act );
+  if (sol->dir != NULL)
+  {
+    DeallocateVector( sol->dir     );
+    DeallocateVector( sol->fig_dir );
+    free( sol->fixed );
+  }
+  if (sol->rho != NULL)
+  {
+    DeallocateVector( sol->rho   );
+    DeallocateVector( sol->a_hst );
+    DeallocateMatrix( sol->s_hst );
+    DeallocateMatrix( sol->y_hst );
+  }
+  DeallocateWienerFilter(sol);
+}
+int IterateDeconvolution(ConvPlan *plan, Solver *sol, int cnt)
+{
+  if (sol->step_mode == STEP_BB)
+  {
+    return IterateBarzilaiBorwein(plan, sol, cnt);
+  }
+  if (sol->step_mode == STEP_FISTA)
+  {
+    return IterateFISTA(plan, sol, cnt);
+  }
+  if (sol->step_mode == STEP_CG)
+  {
+    return IterateConjugateGradient(plan, sol, cnt);
+  }
+  if (sol->step_mode == STEP_LBFGSB)
+  {
+    return IterateLBFGSB(plan, sol, cnt);
+  }
+  if (sol->step_mode == STEP_RL || sol->step_mode == STEP_RLACC)
+  {
+    return IterateRichardsonLucy(plan, sol, cnt);
+  }
+  if (sol->step_mode != STEP_SHRINK)
+  {
+    return IterateLineSearch(plan, sol, cnt);
+  }
+  if (sol->incr_fig == VALID)
+  {
+    return IterateIncremental(plan, sol, cnt);
+  }
+  if (sol->backtrack == VALID)
+  {
+    return IterateBacktracking(plan, sol, cnt);
+  }
+  return IterateLandweber(plan, sol, cnt);
+}
+// dwelltime += alpha*(err x unit); a step worsening the errors
+//   lessens alpha, but is kept as it is
+int IterateLandweber(ConvPlan *plan, Solver *sol, int cnt)
+{
+  int    i;
+  int    s_cnt = sol->hn_uni, e_cnt = sol->n_all-sol->hn_uni;
+  double alpha = sol->alpha, offset_time = sol->offset_time;
+  double *update = sol->update, *dwelltime = sol->dwelltime;
+  sol->rms_bef = sol->rms_aft;  
+  if (sol->normal_eq == VALID)
+  {
+    // apply (unit x unit) to the dwell time and get the update
+    ApplyNormal(plan, dwelltime, sol->normal);
+    sol->rms_aft = CalcNormalUpdate(sol->n_all, sol->n_tgt, 
+        sol->hn_uni, sol->sq_tgt, sol->cor_tgt, sol->normal, 
+        dwelltime, update);
+  }
+  else
+  {
+    // convolute the unit sputter yield with the dwell time
+    //   and calculate the errors between the target and the figure
+    sol->rms_aft = ConvoluteErrors(plan, dwelltime, sol->target, 
+        sol->real_fig, sol->error);
+  }
+  // lessen alpha if the current errors worsen
+  if (sol->rms_bef + RoundingRMS(plan, sol) < sol->rms_aft)
+  {
+    ControlAlpha(plan, sol, INVALID, cnt, sol->rms_aft);
+    return 0;
+  }
+  ControlAlpha(plan, sol, VALID, cnt, sol->rms_aft);
+  if (sol->normal_eq != VALID)
+  {
+    // calculate the evaluation function (err x unit),
+    //   and refresh the dwelltime at once
+    if (BeginActiveSet(plan, sol) != VALID)
+    {
+      CorrelateUpdate(plan, sol->error, alpha, offset_time, dwelltime);
+      EndActiveSet(plan, sol, INVALID, NULL);
+      return 0;
+    }
+    // the update of all the samples refreshes the active set
+    CorrelateErrors(plan, sol->error, update);
+    EndActiveSet(plan, sol, VALID, update);
+  }
+  // refresh the dwelltime using (t=t-alpha × (p-f))
+#pragma omp parallel for default(none)       \
+  private(i)                                 \
+  shared(s_cnt,e_cnt,alpha,update,offset_time,dwelltime)
+  for (i=s_cnt; i<e_cnt; i++)
+  {
+    dwelltime[i] += (alpha*update[i]);
+    // limit the minimum dwell time
+    if (dwelltime[i] < offset_time)
+    {
+      dwelltime[i] = offset_time;
+    }
+  }
+  return 0;
+}
+// alpha lessened by ls_alpha after a step worsening the errors 
+//   (down to lim_alpha), and enlarged by mr_alpha after n_grow 
+//   steps lessening them in a row (up to max_alpha); 
+//   PREC_MIXED switches to double instead of lessening alpha
+int ControlAlpha(ConvPlan *plan, Solver *sol, int accept, int cnt, 
+    double rms)
+{
+  if (accept != VALID)
+  {
+    sol->n_acc = 0;
+    if (SwitchToDouble(plan, "rejected step") == VALID) return 0;
+    if (sol->alpha*sol->ls_alpha > sol->lim_alpha)
+    {
+      sol->alpha *= sol->ls_alpha;
+      sol->n_dec++;
+      printf("Multiplied alpha by %9.4lf\n", sol->ls_alpha);
+      printf("loop: %9d, alpha: %9.4lf, rms: %9.4lf\n",
+          cnt, sol->alpha, rms);
+    }
+    return 0;
+  }
+  sol->n_acc++;
+  if (sol->mr_alpha > 1.0 && sol->n_acc >= sol->n_grow 
+      && sol->alpha*sol->mr_alpha <= sol->max_alpha)
+  {
+    sol->alpha *= sol->mr_alpha;
+    sol->n_inc++;
+    sol->n_acc = 0;
+  }
+  return 0;
+}
+// the worsening of the RMS to be ignored while the float kernels 
+//   are used, which is within their rounding errors
+double RoundingRMS(ConvPlan *plan, Solver *sol)
+{
+  return (plan->single == VALID) ? sol->rms_rnd : 0.0;
+}
+// the active set of the samples held at offset_time, 
+//   refreshed first of all
+int InitActiveSet(Solver *sol)
+{
+  int i;
+  if (sol->step_mode != STEP_SHRINK || sol->normal_eq == VALID)
+  {
+    printf("active_set is ignored with normal_eq and step_mode.\n");
+    return 0;
+  }
+  sol->act = (char*)AllocateVector(sizeof(char), sol->n_all);
+  for (i=0; i<sol->n_all; i++) sol->act[i] = INVALID;
+  sol->n_act = 0;
+  sol->n_cor = 0;
+  return 0;
+}
+// VALID when the next correlation should compute all the samples 
+//   to refresh the active set, otherwise the rows of the set 
+//   are skipped
+int BeginActiveSet(ConvPlan *plan, Solver *sol)
+{
+  if (sol->act == NULL) return INVALID;
+  if (sol->n_cor++ % (int)N_LOOPACTIVE == 0) return VALID;
+  plan->act = sol->act;
+  return INVALID;
+}
+// the active set from the update of all the samples (refresh)
+int EndActiveSet(ConvPlan *plan, Solver *sol, int refresh, 
+    double *update)
+{
+  int    i, n_act = 0;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double offset_time = sol->offset_time;
+  double *dwelltime = sol->dwelltime;
+  char   *act = sol->act;
+  plan->act = NULL;
+  if (refresh != VALID) return 0;
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,hn_uni,offset_time,dwelltime,update,act) \
+  reduction(+:n_act)
+  for (i=0; i<n_all; i++)
+  {
+    act[i] = INVALID;
+    if (i >= hn_uni && i < n_all-hn_uni 
+        && dwelltime[i] <= offset_time && update[i] < 0.0)
+    {
+      act[i] = VALID;
+      n_act++;
+    }
+  }
+  sol->n_act = n_act;
+  return 0;
+}
+// dwelltime += alpha*update with real_fig += alpha*(unit * update);
+//   a step worsening the errors is discarded in O(n_all)
+int IterateIncremental(ConvPlan *plan, Solver *sol, int cnt)
+{
+  int    i, j, n_clp = 0, refresh;
+  int    n_tgt = sol->n_tgt, n_uni = sol->n_uni;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double alpha = sol->alpha, offset_time = sol->offset_time;
+  double rms;
+  double *unit = plan->unit, *tmp;
+  double *update = sol->update, *fig_upd = sol->fig_upd;
+  double *dwelltime = sol->dwelltime, *real_fig = sol->real_fig;
+  double *dwell_trl = sol->dwell_trl, *fig_trl = sol->fig_trl;
+  double *clp_cor = sol->clp_cor;
+  if (sol->fresh != VALID)
+  {
+    // convolute the figure from scratch at times
+    if (sol->n_step % (int)N_LOOPFIG == 0)
+    {
+      sol->rms_cur = ConvoluteErrors(plan, dwelltime, sol->target, 
+          real_fig, sol->error);
+    }
+    // the samples held at offset_time are not moved
+    refresh = BeginActiveSet(plan, sol);
+    CorrelateErrors(plan, sol->error, update);
+    EndActiveSet(plan, sol, refresh, update);
+#pragma omp parallel for default(none)  \
+    private(i)                          \
+    shared(n_all,hn_uni,offset_time,dwelltime,update)
+    for (i=0; i<n_all; i++)
+    {
+      if (i < hn_uni || i >= n_all-hn_uni 
+          || (dwelltime[i] <= offset_time && update[i] < 0.0))
+      {
+        update[i] = 0.0;
+      }
+    }
+    ConvoluteFigure(plan, update, fig_upd);
+    sol->fresh = VALID;
+  }
+  // the trial step, and the dwell time cut by offset_time
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,hn_uni,alpha,offset_time,dwelltime,update, \
+    real_fig,fig_upd,dwell_trl,fig_trl,clp_cor) \
+  reduction(+:n_clp)
+  for (i=0; i<n_all; i++)
+  {
+    dwell_trl[i] = dwelltime[i] + alpha*update[i];
+    fig_trl[i]   = real_fig[i]  + alpha*fig_upd[i];
+    clp_cor[i]   = 0.0;
+    if (i >= hn_uni && i < n_all-hn_uni && dwell_trl[i] < offset_time)
+    {
+      clp_cor[i]   = offset_time - dwell_trl[i];
+      dwell_trl[i] = offset_time;
+      n_clp++;
+    }
+  }
+  if (n_clp > (n_all-2*hn_uni)/8)
+  {
+    // too many samples to correct one by one
+    rms = ConvoluteErrors(plan, dwell_trl, sol->target, 
+        fig_trl, sol->err_trl);
+  }
+  else
+  {
+    for (i=hn_uni; i<n_all-hn_uni && n_clp>0; i++)
+    {
+      if (clp_cor[i] == 0.0) continue;
+      for (j=0; j<n_uni; j++)
+      {
+        fig_trl[i-hn_uni+j] += clp_cor[i]*unit[j];
+      }
+      n_clp--;
+    }
+    rms = CalcErrors(n_tgt, n_uni, sol->target, fig_trl, sol->err_trl);
+  }
+  sol->rms_bef = sol->rms_cur;
+  sol->rms_aft = rms;
+  // discard the step and lessen alpha if the errors worsen
+  if (sol->rms_cur + RoundingRMS(plan, sol) < rms 
+      && alpha*sol->ls_alpha > sol->lim_alpha)
+  {
+    sol->n_rej++;
+    ControlAlpha(plan, sol, INVALID, cnt, rms);
+    return 0;
+  }
+  ControlAlpha(plan, sol, VALID, cnt, rms);
+  // accept the step by exchanging the arrays with the trial ones
+  tmp = sol->dwelltime;
+  sol->dwelltime = dwell_trl;    sol->dwell_trl = tmp;
+  tmp = sol->real_fig;
+  sol->real_fig  = fig_trl;      sol->fig_trl   = tmp;
+  tmp = sol->error;
+  sol->error     = sol->err_trl; sol->err_trl   = tmp;
+  sol->rms_cur = rms;
+  sol->fresh   = INVALID;
+  sol->n_step++;
+  return 0;
+}
+// dwelltime += alpha*(err x unit) cut by offset_time, accepted only 
+//   when the errors are lessened enough (Armijo); a rejected step 
+//   is retried from the kept arrays and update with lessened alpha
+int IterateBacktracking(ConvPlan *plan, Solver *sol, int cnt)
+{
+  int    i, refresh;
+  int    n_tgt = sol->n_tgt, hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double alpha = sol->alpha, offset_time = sol->offset_time;
+  double rms, rnd, dec = 0.0;
+  double *update = sol->update, *dwelltime = sol->dwelltime;
+  double *dwell_trl = sol->dwell_trl, *tmp;
+  if (sol->fresh != VALID)
+  {
+    // the errors of the accepted step are kept from the trial
+    if (sol->n_step == 0)
+    {
+      sol->rms_cur = ConvoluteErrors(plan, dwelltime, sol->target, 
+          sol->real_fig, sol->error);
+    }
+    refresh = BeginActiveSet(plan, sol);
+    CorrelateErrors(plan, sol->error, update);
+    EndActiveSet(plan, sol, refresh, update);
+    sol->fresh = VALID;
+  }
+  sol->rms_bef = sol->rms_cur;
+  // the trial step cut by offset_time, and the decrease expected
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,hn_uni,alpha,offset_time,dwelltime,update,dwell_trl) \
+  reduction(+:dec)
+  for (i=0; i<n_all; i++)
+  {
+    dwell_trl[i] = dwelltime[i];
+    if (i < hn_uni || i >= n_all-hn_uni) continue;
+    dwell_trl[i] += alpha*update[i];
+    if (dwell_trl[i] < offset_time) dwell_trl[i] = offset_time;
+    dec += update[i]*(dwell_trl[i] - dwelltime[i]);
+  }
+  rms = ConvoluteErrors(plan, dwell_trl, sol->target, 
+      sol->fig_trl, sol->err_trl);
+  sol->rms_aft = rms;
+  rnd = RoundingRMS(plan, sol);
+  if (n_tgt*(rms-rnd)*(rms-rnd) > n_tgt*sol->rms_cur*sol->rms_cur 
+      - 2.0*BT_GAMMA*dec && rms > rnd)
+  {
+    // go back to the kept arrays, and lessen alpha
+    sol->n_rej++;
+    if (alpha*sol->ls_alpha <= sol->lim_alpha && plan->mixed != VALID)
+    {
+      // the same step would be tried again
+      sol->stop = STOP_ALPHA;
+      return 0;
+    }
+    ControlAlpha(plan, sol, INVALID, cnt, rms);
+    return 0;
+  }
+  ControlAlpha(plan, sol, VALID, cnt, rms);
+  tmp = sol->dwelltime;
+  sol->dwelltime = dwell_trl;    sol->dwell_trl = tmp;
+  tmp = sol->real_fig;
+  sol->real_fig  = sol->fig_trl; sol->fig_trl   = tmp;
+  tmp = sol->error;
+  sol->error     = sol->err_trl; sol->err_trl   = tmp;
+  sol->rms_cur = rms;
+  sol->fresh   = INVALID;
+  sol->n_step++;
+  return 0;
+}
+// dwelltime += alpha*update with alpha minimizing the errors,
+//   |update|^2/|unit * update|^2, and real_fig refreshed with it;
+//   STEP_PROJECTED stops on the way to the step cut by offset_time
+int IterateLineSearch(ConvPlan *plan, Solver *sol, int cnt)
+{
+  int    i;
+  int    n_tgt = sol->n_tgt, n_uni = sol->n_uni;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  int    proj = (sol->step_mode == STEP_PROJECTED) ? VALID : INVALID;
+  double offset_time = sol->offset_time;
+  double alpha, beta, sq_upd = 0.0, sq_fig = 0.0;
+  double *error = sol->error;
+  double *update = sol->update, *fig_upd = sol->fig_upd;
+  double *dwelltime = sol->dwelltime, *real_fig = sol->real_fig;
+  double *dir = update;
+  // convolute the figure from scratch at times
+  if (sol->n_step % (int)N_LOOPFIG == 0)
+  {
+    sol->rms_cur = ConvoluteErrors(plan, dwelltime, sol->target, 
+        real_fig, error);
+  }
+  sol->rms_bef = sol->rms_cur;
+  // STEP_PROJECTED does not move the samples held at offset_time
+  CorrelateErrors(plan, error, update);
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,hn_uni,proj,offset_time,dwelltime,update) \
+  reduction(+:sq_upd)
+  for (i=0; i<n_all; i++)
+  {
+    if (i < hn_uni || i >= n_all-hn_uni || (proj == VALID 
+          && dwelltime[i] <= offset_time && update[i] < 0.0))
+    {
+      update[i] = 0.0;
+    }
+    sq_upd += update[i]*update[i];
+  }
+  if (sol->pre != NULL)
+  {
+    dir = sol->pre_upd;
+    sq_upd = ApplyPrecond(sol, update, dir);
+  }
+  ConvoluteFigure(plan, dir, fig_upd);
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_tgt,n_uni,fig_upd)           \
+  reduction(+:sq_fig)
+  for (i=n_uni; i<n_uni+n_tgt; i++)
+  {
+    sq_fig += fig_upd[i]*fig_upd[i];
+  }
+  if (sq_fig <= 0.0)
+  {
+    sol->rms_aft = sol->rms_cur;
+    return 0;
+  }
+  alpha = sq_upd/sq_fig;
+  TakeProjectedStep(plan, sol, alpha, dir, fig_upd, proj, &beta);
+  sol->rms_cur = CalcErrors(n_tgt, n_uni, sol->target, 
+      real_fig, error);
+  sol->rms_aft = sol->rms_cur;
+  sol->alpha   = beta*alpha;
+  sol->n_step++;
+  return 0;
+}
+// dwelltime += alpha*dir, where dir is conjugate on the free samples;
+//   the samples held at offset_time are fixed, and a step cut 
+//   by offset_time or a change of them restarts dir from the update
+int IterateConjugateGradient(ConvPlan *plan, Solver *sol, int cnt)
+{
+  int    i, n_chg = 0;
+  int    n_tgt = sol->n_tgt, n_uni = sol->n_uni;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double offset_time = sol->offset_time;
+  double alpha, beta, sq_grd = 0.0, dot = 0.0, sq_fig = 0.0;
+  double *error = sol->error, *update = sol->update;
+  double *dwelltime = sol->dwelltime, *real_fig = sol->real_fig;
+  double *dir = sol->dir, *fig_dir = sol->fig_dir;
+  double *pre_upd = update;
+  char   *fixed = sol->fixed, fix;
+  int    rst;
+  // convolute the figure from scratch at times, and restart
+  if (sol->n_step % (int)N_LOOPFIG == 0)
+  {
+    sol->rms_cur = ConvoluteErrors(plan, dwelltime, sol->target, 
+        real_fig, error);
+    sol->cg_rst  = VALID;
+  }
+  sol->rms_bef = sol->rms_cur;
+  rst = sol->cg_rst;
+  // the update on the free samples; the samples going up 
+  //   from offset_time are released only at a restart
+  CorrelateErrors(plan, error, update);
+#pragma omp parallel for default(none)  \
+  private(i,fix)                        \
+  shared(n_all,hn_uni,offset_time,rst,dwelltime,update,fixed) \
+  reduction(+:sq_grd,n_chg)
+  for (i=0; i<n_all; i++)
+  {
+    fix = (dwelltime[i] <= offset_time && (update[i] < 0.0 
+          || (rst != VALID && fixed[i] == VALID))) ? VALID : INVALID;
+    if (i < hn_uni || i >= n_all-hn_uni || fix == VALID)
+    {
+      update[i] = 0.0;
+    }
+    if (fixed[i] != fix) n_chg++;
+    fixed[i] = fix;
+    sq_grd  += update[i]*update[i];
+  }
+  if (sq_grd <= 0.0)
+  {
+    // converged on the free samples
+    sol->cg_rst  = VALID;
+    sol->rms_aft = sol->rms_cur;
+    return 0;
+  }
+  if (sol->pre != NULL)
+  {
+    pre_upd = sol->pre_upd;
+    sq_grd  = ApplyPrecond(sol, update, pre_upd);
+  }
+  // the conjugate direction, or the update after a restart
+  beta = 0.0;
+  if (rst != VALID && n_chg == 0)
+  {
+    beta = sq_grd/sol->sq_grd;
+  }
+  else
+  {
+    sol->n_rst++;
+  }
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,beta,update,pre_upd,dir) \
+  reduction(+:dot)
+  for (i=0; i<n_all; i++)
+  {
+    dir[i] = pre_upd[i] + beta*dir[i];
+    dot   += update[i]*dir[i];
+  }
+  ConvoluteFigure(plan, dir, fig_dir);
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_tgt,n_uni,fig_dir)           \
+  reduction(+:sq_fig)
+  for (i=n_uni; i<n_uni+n_tgt; i++)
+  {
+    sq_fig += fig_dir[i]*fig_dir[i];
+  }
+  if (sq_fig <= 0.0 || dot <= 0.0)
+  {
+    sol->cg_rst = VALID;
+    sol->rms_aft = sol->rms_cur;
+    return 0;
+  }
+  alpha = dot/sq_fig;
+  // the samples cut by offset_time restart the direction only 
+  //   when they are held there at the next loop (n_chg)
+  TakeProjectedStep(plan, sol, alpha, dir, fig_dir, VALID, &beta);
+  sol->cg_rst  = INVALID;
+  sol->sq_grd  = sq_grd;
+  sol->rms_cur = CalcErrors(n_tgt, n_uni, sol->target, 
+      real_fig, error);
+  sol->rms_aft = sol->rms_cur;
+  sol->alpha   = beta*alpha;
+  sol->n_step++;
+  return 0;
+}
+// dwelltime += alpha*dir, where dir is the update on the free 
+//   samples multiplied by the inverse Hessian of L-BFGS (two-loop
+//   recursion); the last step is kept in dwell_trl, and update 
+//   goes to y_hst before it is overwritten
+int IterateLBFGSB(ConvPlan *plan, Solver *sol, int cnt)
+{
+  int    i, k, m, n_pair = sol->n_pair, n_hist = sol->n_hist;
+  int    n_tgt = sol->n_tgt, n_uni = sol->n_uni;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double offset_time = sol->offset_time;
+  double alpha, beta, dot, sq_fig, sy, gamma;
+  double *a_k = sol->a_hst;
+  double *error = sol->error, *update = sol->update;
+  double *dwelltime = sol->dwelltime, *real_fig = sol->real_fig;
+  double *dir = sol->dir, *fig_dir = sol->fig_dir;
+  double *s_new, *y_new, *rho = sol->rho;
+  char   *fixed = sol->fixed;
+  // convolute the figure from scratch at times
+  if (sol->n_step % (int)N_LOOPFIG == 0)
+  {
+    sol->rms_cur = ConvoluteErrors(plan, dwelltime, sol->target, 
+        real_fig, error);
+  }
+  sol->rms_bef = sol->rms_cur;
+  // the new pair, s = the last step and y = -(its change of update)
+  m = sol->i_pair;
+  s_new = sol->s_hst[m];
+  y_new = sol->y_hst[m];
+  if (sol->n_step > 0)
+  {
+    memcpy(s_new, sol->dwell_trl, sizeof(double)*n_all);
+    memcpy(y_new, update,         sizeof(double)*n_all);
+  }
+  CorrelateErrors(plan, error, update);
+  sy = 0.0;
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,hn_uni,offset_time,dwelltime,update,fixed) 
+  for (i=0; i<n_all; i++)
+  {
+    fixed[i] = (dwelltime[i] <= offset_time && update[i] < 0.0) ? 
+      VALID : INVALID;
+    if (i < hn_uni || i >= n_all-hn_uni) update[i] = 0.0;
+  }
+  if (sol->n_step > 0)
+  {
+#pragma omp parallel for default(none)  \
+    private(i)                          \
+    shared(n_all,update,s_new,y_new)    \
+    reduction(+:sy)
+    for (i=0; i<n_all; i++)
+    {
+      y_new[i] -= update[i];
+      sy += s_new[i]*y_new[i];
+    }
+    // (s, y) = |unit * s|^2, which vanishes without a step
+    if (sy > 0.0)
+    {
+      rho[m] = 1.0/sy;
+      sol->i_pair = (m+1) % n_hist;
+      if (n_pair < n_hist) n_pair++;
+    }
+  }
+  // the two-loop recursion on the free samples, from the newest pair
+  for (i=0; i<n_all; i++)
+  {
+    dir[i] = (fixed[i] == VALID) ? 0.0 : update[i];
+  }
+  gamma = 1.0;
+  for (k=0; k<n_pair; k++)
+  {
+    m   = (sol->i_pair - 1 - k + n_hist) % n_hist;
+    dot = 0.0;
+#pragma omp parallel for default(none)  \
+    private(i)                          \
+    shared(n_all,m,sol,dir,fixed)       \
+    reduction(+:dot)
+    for (i=0; i<n_all; i++)
+    {
+      if (fixed[i] != VALID) dot += sol->s_hst[m][i]*dir[i];
+    }
+    a_k[k] = rho[m]*dot;
+#pragma omp parallel for default(none)  \
+    private(i)                          \
+    shared(n_all,m,k,a_k,sol,dir,fixed)
+    for (i=0; i<n_all; i++)
+    {
+      if (fixed[i] != VALID) dir[i] -= a_k[k]*sol->y_hst[m][i];
+    }
+    if (k == 0)
+    {
+      // the initial Hessian (s, y)/(y, y) of the newest pair
+      gamma = 0.0;
+#pragma omp parallel for default(none)  \
+      private(i)                        \
+      shared(n_all,m,sol)               \
+      reduction(+:gamma)
+      for (i=0; i<n_all; i++)
+      {
+        gamma += sol->y_hst[m][i]*sol->y_hst[m][i];
+      }
+      gamma = 1.0/(rho[m]*gamma);
+    }
+  }
+  for (i=0; i<n_all; i++) dir[i] *= gamma;
+  for (k=n_pair-1; k>=0; k--)
+  {
+    m   = (sol->i_pair - 1 - k + n_hist) % n_hist;
+    dot = 0.0;
+#pragma omp parallel for default(none)  \
+    private(i)                          \
+    shared(n_all,m,sol,dir,fixed)       \
+    reduction(+:dot)
+    for (i=0; i<n_all; i++)
+    {
+      if (fixed[i] != VALID) dot += sol->y_hst[m][i]*dir[i];
+    }
+    beta = rho[m]*dot;
+#pragma omp parallel for default(none)  \
+    private(i)                          \
+    shared(n_all,m,k,a_k,beta,sol,dir,fixed)
+    for (i=0; i<n_all; i++)
+    {
+      if (fixed[i] != VALID) dir[i] += (a_k[k]-beta)*sol->s_hst[m][i];
+    }
+  }
+  // back to the update when dir does not go down the errors
+  dot = 0.0;
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,update,dir)              \
+  reduction(+:dot)
+  for (i=0; i<n_all; i++)
+  {
+    dot += update[i]*dir[i];
+  }
+  if (dot <= 0.0)
+  {
+    dot = 0.0;
+    for (i=0; i<n_all; i++)
+    {
+      dir[i] = (fixed[i] == VALID) ? 0.0 : update[i];
+      dot   += update[i]*dir[i];
+    }
+    n_pair = 0;
+  }
+  sol->n_pair = n_pair;
+  // the step minimizing the errors along dir, cut by offset_time
+  ConvoluteFigure(plan, dir, fig_dir);
+  sq_fig = 0.0;
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_tgt,n_uni,fig_dir)           \
+  reduction(+:sq_fig)
+  for (i=n_uni; i<n_uni+n_tgt; i++)
+  {
+    sq_fig += fig_dir[i]*fig_dir[i];
+  }
+  if (sq_fig <= 0.0 || dot <= 0.0)
+  {
+    sol->rms_aft = sol->rms_cur;
+    return 0;
+  }
+  alpha = dot/sq_fig;
+  TakeProjectedStep(plan, sol, alpha, dir, fig_dir, VALID, &beta);
+  // the cut step may go up the errors, when the pairs are cleared 
+  //   to start from the update, which always goes down
+  if (beta <= 0.0) sol->n_pair = 0;
+  // the step taken is kept for the next pair
+  for (i=0; i<n_all; i++) sol->dwell_trl[i] *= beta;
+  sol->rms_cur = CalcErrors(n_tgt, n_uni, sol->target, 
+      real_fig, error);
+  sol->rms_aft = sol->rms_cur;
+  sol->alpha   = beta*alpha;
+  sol->n_step++;
+  return 0;
+}
+// the circulant preconditioner from the spectrum of the unit
+//   for an array of n_all, which is not wrapped around in n_fft
+int InitPrecond(Solver *sol, ConvPlan *plan, double pre_eps)
+{
+  if (sol->step_mode != STEP_EXACT && sol->step_mode != STEP_PROJECTED
+      && sol->step_mode != STEP_CG)
+  {
+    printf("pre_eps is ignored except in STEP_EXACT, "
+        "STEP_PROJECTED and STEP_CG.\n");
+    return 0;
+  }
+  return InitWienerFilter(sol, plan, pre_eps);
+}
+// spc_pre = 1/(|FFT(unit)|^2 + eps*L)/n_fft on a CONV_FFT plan,
+//   applied by ApplyPrecond
+int InitWienerFilter(Solver *sol, ConvPlan *plan, double eps)
+{
+  int    i, n_hlf, n_fft;
+  double pw, pw_max = 0.0;
+  double *u;
+  sol->pre_eps = eps;
+  sol->pre     = (ConvPlan*)AllocateVector(sizeof(ConvPlan), 1);
+  InitConvPlan(sol->pre, CONV_FFT, SIMD_GENERIC, PREC_DOUBLE, 
+      plan->n_tgt, plan->n_uni, plan->hn_uni, plan->n_all, 
+      plan->unit);
+  n_fft = sol->pre->n_fft;
+  n_hlf = n_fft/2;
+  u = sol->pre->spc_uni;
+  sol->spc_pre = (double*)AllocateVector(sizeof(double), n_hlf+1);
+  sol->pre_upd = (double*)AllocateVector(sizeof(double), sol->n_all);
+  // spc_uni is scaled by 1/n_fft
+  for (i=0; i<=n_hlf; i++)
+  {
+    pw = n_fft*n_fft*(u[2*i]*u[2*i] + u[2*i+1]*u[2*i+1]);
+    sol->spc_pre[i] = pw;
+    if (pw_max < pw) pw_max = pw;
+  }
+  for (i=0; i<=n_hlf; i++)
+  {
+    sol->spc_pre[i] = 1.0/((sol->spc_pre[i] + eps*pw_max)*n_fft);
+  }
+  return 0;
+}
+void DeallocateWienerFilter(Solver *sol)
+{
+  if (sol->pre == NULL) return;
+  DeallocateConvPlan( sol->pre );
+  free( sol->pre );
+  DeallocateVector( sol->spc_pre );
+  DeallocateVector( sol->pre_upd );
+  sol->pre_eps = 0.0;
+  sol->pre     = NULL;
+  sol->spc_pre = NULL;
+  sol->pre_upd = NULL;
+}
+// dwelltime = offset_time + the Wiener inverse of the errors 
+//   of the current dwell time (offset_time), cut by offset_time; 
+//   the errors are joined linearly from the end to the beginning 
+//   over the rest of n_fft, so that they look periodic to the FFT,
+//   and the dwell time is restored when the errors worsen
+int InitWarmStart(ConvPlan *plan, Solver *sol, double wnr_eps)
+{
+  int    i, m, n_fft, n_hlf;
+  int    n_tgt = sol->n_tgt, n_uni = sol->n_uni;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double offset_time = sol->offset_time, rms_bef, rms_aft, re, im;
+  double *dwelltime = sol->dwelltime, *error = sol->error;
+  double *dwell_bef, *x, *s, *u, *w;
+  dwell_bef = (double*)AllocateVector(sizeof(double), n_all);
+  memcpy(dwell_bef, dwelltime, sizeof(double)*n_all);
+  rms_bef = ConvoluteErrors(plan, dwelltime, sol->target, 
+      sol->real_fig, error);
+  InitWienerFilter(sol, plan, wnr_eps);
+  n_fft = sol->pre->n_fft;
+  n_hlf = n_fft/2;
+  x = sol->pre->real_buf; s = sol->pre->spc_buf;
+  u = sol->pre->spc_uni;  w = sol->spc_pre;
+  for (i=0; i<n_fft; i++)
+  {
+    m    = (i - n_uni + n_fft) % n_fft;
+    x[i] = (m < n_tgt) ? error[m] : error[n_tgt-1] 
+      + (error[0] - error[n_tgt-1])*(m - n_tgt + 1)/(n_fft - n_tgt + 1);
+  }
+  TransformRealFFT(sol->pre, x, s);
+  // (unit x error) filtered by 1/(|FFT(unit)|^2 + wnr_eps*L)
+  for (i=0; i<=n_hlf; i++)
+  {
+    re = s[2*i]*u[2*i  ] + s[2*i+1]*u[2*i+1];
+    im = s[2*i+1]*u[2*i] - s[2*i  ]*u[2*i+1];
+    s[2*i  ] = re*n_fft*w[i];
+    s[2*i+1] = im*n_fft*w[i];
+  }
+  InverseRealFFT(sol->pre, s, x);
+  for (i=hn_uni; i<n_all-hn_uni; i++)
+  {
+    dwelltime[i] += x[i];
+    if (dwelltime[i] < offset_time) dwelltime[i] = offset_time;
+  }
+  DeallocateWienerFilter(sol);
+  rms_aft = ConvoluteErrors(plan, dwelltime, sol->target, 
+      sol->real_fig, sol->error);
+  printf("Warm start: rms: %9.4lf -> %9.4lf\n", rms_bef, rms_aft);
+  if (rms_aft > rms_bef)
+  {
+    printf("The warm start is discarded.\n");
+    memcpy(dwelltime, dwell_bef, sizeof(double)*n_all);
+  }
+  DeallocateVector( dwell_bef );
+  return 0;
+}
+// dst = the filtered src, and 0 where src is 0 (the fixed samples 
+//   and the margins), returning (src, dst)
+double ApplyPrecond(Solver *sol, double *src, double *dst)
+{
+  int    i;
+  int    n_all = sol->n_all, n_hlf = sol->pre->n_fft/2;
+  double dot = 0.0;
+  double *x = sol->pre->real_buf, *s = sol->pre->spc_buf;
+  double *w = sol->spc_pre;
+  InitVectorToDblZero(sol->pre->n_fft, x);
+  memcpy(x, src, sizeof(double)*n_all);
+  TransformRealFFT(sol->pre, x, s);
+  for (i=0; i<=n_hlf; i++)
+  {
+    s[2*i  ] *= w[i];
+    s[2*i+1] *= w[i];
+  }
+  InverseRealFFT(sol->pre, s, x);
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,src,dst,x)               \
+  reduction(+:dot)
+  for (i=0; i<n_all; i++)
+  {
+    dst[i] = (src[i] == 0.0) ? 0.0 : x[i];
+    dot   += src[i]*dst[i];
+  }
+  return dot;
+}
+// dwelltime += beta*alpha*dir cut by offset_time, and real_fig 
+//   refreshed with fig_dir = (unit * dir); proj gives beta (<= 1) 
+//   of the best point on the way, returning the samples cut
+int TakeProjectedStep(ConvPlan *plan, Solver *sol, double alpha, 
+    double *dir, double *fig_dir, int proj, double *beta)
+{
+  int    i, j, n_clp = 0, n_cut;
+  int    n_tgt = sol->n_tgt, n_uni = sol->n_uni;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double offset_time = sol->offset_time;
+  double sq_fig = 0.0, dot = 0.0, b = 1.0;
+  double *unit = plan->unit, *error = sol->error;
+  double *dwelltime = sol->dwelltime, *real_fig = sol->real_fig;
+  double *step = sol->dwell_trl, *fig_stp = sol->fig_trl;
+  double *clp_cor = sol->clp_cor;
+  // the step cut by offset_time, and its figure
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,hn_uni,alpha,offset_time,dwelltime,dir, \
+    fig_dir,step,fig_stp,clp_cor)       \
+  reduction(+:n_clp)
+  for (i=0; i<n_all; i++)
+  {
+    step[i]    = alpha*dir[i];
+    fig_stp[i] = alpha*fig_dir[i];
+    clp_cor[i] = 0.0;
+    if (i >= hn_uni && i < n_all-hn_uni 
+        && dwelltime[i]+step[i] < offset_time)
+    {
+      clp_cor[i] = offset_time - dwelltime[i] - step[i];
+      step[i]    = offset_time - dwelltime[i];
+      n_clp++;
+    }
+  }
+  n_cut = n_clp;
+  if (n_clp > (n_all-2*hn_uni)/8)
+  {
+    // too many samples to correct one by one
+    ConvoluteFigure(plan, step, fig_stp);
+  }
+  else
+  {
+    for (i=hn_uni; i<n_all-hn_uni && n_clp>0; i++)
+    {
+      if (clp_cor[i] == 0.0) continue;
+      for (j=0; j<n_uni; j++)
+      {
+        fig_stp[i-hn_uni+j] += clp_cor[i]*unit[j];
+      }
+      n_clp--;
+    }
+  }
+  if (proj == VALID)
+  {
+    // the best point between the dwell time and the cut step,
+    //   both of which are above offset_time
+#pragma omp parallel for default(none)  \
+    private(i)                          \
+    shared(n_tgt,n_uni,error,fig_stp)   \
+    reduction(+:dot,sq_fig)
+    for (i=0; i<n_tgt; i++)
+    {
+      dot    += error[i]*fig_stp[i+n_uni];
+      sq_fig += fig_stp[i+n_uni]*fig_stp[i+n_uni];
+    }
+    if (sq_fig > 0.0 && dot < sq_fig)
+    {
+      b = (dot > 0.0) ? dot/sq_fig : 0.0;
+    }
+  }
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,b,step,fig_stp,dwelltime,real_fig)
+  for (i=0; i<n_all; i++)
+  {
+    dwelltime[i] += b*step[i];
+    real_fig[i]  += b*fig_stp[i];
+  }
+  *beta = b;
+  return n_cut;
+}
+// dwelltime += alpha*update with the spectral step of the last two
+//   accepted steps; a trial step worse than all of the last 
+//   N_NONMONO steps is discarded in O(n_all) with alpha lessened
+int IterateBarzilaiBorwein(ConvPlan *plan, Solver *sol, int cnt)
+{
+  int    i;
+  int    n_tgt = sol->n_tgt, n_all = sol->n_all, hn_uni = sol->hn_uni;
+  double alpha = sol->alpha, offset_time = sol->offset_time;
+  double rms, sq, sq_cur, sq_max = 0.0, dec = 0.0, ss = 0.0, sy = 0.0;
+  double shrink;
+  double *update = sol->update, *upd_trl = sol->upd_trl;
+  double *dwelltime = sol->dwelltime, *dwell_trl = sol->dwell_trl;
+  double *tmp;
+  if (sol->n_hst == 0)
+  {
+    // the errors and the update of the initial dwell time
+    sol->rms_cur = ConvoluteErrors(plan, dwelltime, sol->target, 
+        sol->real_fig, sol->error);
+    CorrelateErrors(plan, sol->error, update);
+    for (i=0; i<hn_uni; i++)
+    {
+      update[i] = update[n_all-1-i] = 0.0;
+    }
+    sol->sq_hst[0] = sol->rms_cur*sol->rms_cur*n_tgt;
+    sol->n_hst = 1;
+  }
+  sol->rms_bef = sol->rms_cur;
+  // the trial step cut by offset_time
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,alpha,offset_time,update,dwelltime,dwell_trl) \
+  reduction(+:dec)
+  for (i=0; i<n_all; i++)
+  {
+    dwell_trl[i] = dwelltime[i] + alpha*update[i];
+    if (update[i] != 0.0 && dwell_trl[i] < offset_time) 
+    {
+      dwell_trl[i] = offset_time;
+    }
+    dec += update[i]*(dwell_trl[i] - dwelltime[i]);
+  }
+  rms = ConvoluteErrors(plan, dwell_trl, sol->target, 
+      sol->fig_trl, sol->err_trl);
+  sol->rms_aft = rms;
+  // discard the step and lessen alpha if the errors are worse 
+  //   than the last N_NONMONO steps
+  sq     = rms*rms*n_tgt;
+  sq_cur = sol->rms_cur*sol->rms_cur*n_tgt;
+  for (i=0; i<sol->n_hst; i++)
+  {
+    if (sq_max < sol->sq_hst[i]) sq_max = sol->sq_hst[i];
+  }
+  if (sq > sq_max - 2.0*BB_GAMMA*dec 
+      && alpha*BB_SHRINK > sol->lim_alpha)
+  {
+    // the minimum of the quadratic through the errors and the slope
+    //   of both ends, kept between 0.1 and BB_SHRINK
+    shrink = BB_SHRINK;
+    if (sq - sq_cur + 2.0*dec > 0.0)
+    {
+      shrink = dec/(sq - sq_cur + 2.0*dec);
+      if (shrink > BB_SHRINK) shrink = BB_SHRINK;
+      if (shrink < 0.1)       shrink = 0.1;
+    }
+    sol->alpha *= shrink;
+    printf("Multiplied alpha by %9.4lf\n", shrink);
+    printf("loop: %9d, alpha: %9.4lf, rms: %9.4lf\n",
+        cnt, sol->alpha, rms);
+    return 0;
+  }
+  // the update of the accepted step, and the spectral step
+  CorrelateErrors(plan, sol->err_trl, upd_trl);
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,hn_uni,update,upd_trl,dwelltime,dwell_trl) \
+  reduction(+:ss,sy)
+  for (i=0; i<n_all; i++)
+  {
+    if (i < hn_uni || i >= n_all-hn_uni)
+    {
+      upd_trl[i] = 0.0;
+    }
+    ss += (dwell_trl[i]-dwelltime[i])*(dwell_trl[i]-dwelltime[i]);
+    sy += (dwell_trl[i]-dwelltime[i])*(update[i]-upd_trl[i]);
+  }
+  if (sy > 0.0 && ss/sy > sol->lim_alpha)
+  {
+    sol->alpha = ss/sy;
+  }
+  // accept the step by exchanging the arrays with the trial ones
+  tmp = sol->dwelltime;
+  sol->dwelltime = dwell_trl;    sol->dwell_trl = tmp;
+  tmp = sol->real_fig;
+  sol->real_fig  = sol->fig_trl; sol->fig_trl   = tmp;
+  tmp = sol->error;
+  sol->error     = sol->err_trl; sol->err_trl   = tmp;
+  tmp = sol->update;
+  sol->update    = upd_trl;      sol->upd_trl   = tmp;
+  sol->sq_hst[(sol->n_step+1) % N_NONMONO] = sq;
+  if (sol->n_hst < N_NONMONO) sol->n_hst++;
+  sol->rms_cur = rms;
+  sol->n_step++;
+  return 0;
+}
+// dwelltime = P(y + alpha*update(y)), y = dwelltime 
+//   + mom*(dwelltime - dwell_prv), where P cuts it by offset_time;
+//   the figure of y is combined from those of the two dwell times
+int IterateFISTA(ConvPlan *plan, Solver *sol, int cnt)
+{
+  int    i;
+  int    n_tgt = sol->n_tgt, n_uni = sol->n_uni;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double alpha = sol->alpha, offset_time = sol->offset_time;
+  double t_nxt, mom, rms, dot = 0.0;
+  double *target = sol->target, *update = sol->update;
+  double *dwelltime = sol->dwelltime, *dwell_prv = sol->dwell_prv;
+  double *dwell_trl = sol->dwell_trl, *err_trl = sol->err_trl;
+  double *real_fig = sol->real_fig, *fig_prv = sol->fig_prv;
+  double *tmp, y;
+  if (sol->t_mom == 0.0)
+  {
+    // no momentum at the initial dwell time
+    sol->rms_cur = ConvoluteErrors(plan, dwelltime, target, 
+        real_fig, sol->error);
+    memcpy(dwell_prv, dwelltime, sizeof(double)*n_all);
+    memcpy(fig_prv,   real_fig,  sizeof(double)*n_all);
+    sol->t_mom = 1.0;
+  }
+  sol->rms_bef = sol->rms_cur;
+  t_nxt = 0.5*(1.0 + sqrt(1.0 + 4.0*sol->t_mom*sol->t_mom));
+  mom   = (sol->t_mom - 1.0)/t_nxt;
+  // the errors of y, and the update there
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_tgt,n_uni,mom,target,real_fig,fig_prv,err_trl)
+  for (i=0; i<n_tgt; i++)
+  {
+    err_trl[i] = target[i] - real_fig[i+n_uni] 
+      - mom*(real_fig[i+n_uni] - fig_prv[i+n_uni]);
+  }
+  CorrelateErrors(plan, err_trl, update);
+  // the step from y cut by offset_time
+#pragma omp parallel for default(none)  \
+  private(i,y)                          \
+  shared(n_all,hn_uni,alpha,mom,offset_time,update, \
+    dwelltime,dwell_prv,dwell_trl)      \
+  reduction(+:dot)
+  for (i=0; i<n_all; i++)
+  {
+    if (i < hn_uni || i >= n_all-hn_uni)
+    {
+      dwell_trl[i] = dwelltime[i];
+      continue;
+    }
+    y = dwelltime[i] + mom*(dwelltime[i] - dwell_prv[i]);
+    dwell_trl[i] = y + alpha*update[i];
+    if (dwell_trl[i] < offset_time) dwell_trl[i] = offset_time;
+    dot += (y - dwell_trl[i])*(dwell_trl[i] - dwelltime[i]);
+  }
+  rms = ConvoluteErrors(plan, dwell_trl, target, 
+      sol->fig_trl, err_trl);
+  sol->rms_aft = rms;
+  sol->t_mom   = t_nxt;
+  if (sol->restart == RESTART_FUNC && rms > sol->rms_cur)
+  {
+    // discard the step, and take the next one without momentum
+    memcpy(dwell_prv, dwelltime, sizeof(double)*n_all);
+    memcpy(fig_prv,   real_fig,  sizeof(double)*n_all);
+    sol->t_mom = 1.0;
+    sol->n_rst++;
+    return 0;
+  }
+  if (sol->restart == RESTART_GRAD && dot > 0.0)
+  {
+    sol->t_mom = 1.0;
+    sol->n_rst++;
+  }
+  // the dwell time goes to the previous one, the trial to the current
+  tmp = sol->dwell_prv;
+  sol->dwell_prv = dwelltime;     sol->dwelltime = dwell_trl;
+  sol->dwell_trl = tmp;
+  tmp = sol->fig_prv;
+  sol->fig_prv   = real_fig;      sol->real_fig  = sol->fig_trl;
+  sol->fig_trl   = tmp;
+  tmp = sol->error;
+  sol->error     = err_trl;       sol->err_trl   = tmp;
+  sol->rms_cur = rms;
+  sol->n_step++;
+  return 0;
+}
+// dwelltime = offset_time + v, where v is multiplied by
+//   (unit x (target/real_fig)) / (unit x 1) as in Richardson-Lucy;
+//   STEP_RLACC extrapolates it along the last step
+int IterateRichardsonLucy(ConvPlan *plan, Solver *sol, int cnt)
+{
+  int    i;
+  int    n_tgt = sol->n_tgt, n_uni = sol->n_uni;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double offset_time = sol->offset_time;
+  double flr = 0.0, sum_uni = 0.0, acc = 0.0, dot = 0.0, sq = 0.0;
+  double fig, x, y;
+  double *target = sol->target, *real_fig = sol->real_fig;
+  double *ratio = sol->err_trl, *update = sol->update;
+  double *rl_nrm = sol->rl_nrm, *rl_stp = sol->rl_stp;
+  double *dwelltime = sol->dwelltime, *dwell_trl = sol->dwell_trl;
+  double *dwell_prv = sol->dwell_prv, *tmp;
+  if (sol->n_step == 0)
+  {
+    // (unit x 1) over the target, and the dwell time raised 
+    //   above offset_time, where the update cannot move it
+    for (i=0; i<n_tgt; i++) ratio[i] = 1.0;
+    CorrelateErrors(plan, ratio, rl_nrm);
+    ConvoluteErrors(plan, dwelltime, target, real_fig, sol->error);
+    for (i=0; i<n_tgt; i++) flr     += sol->error[i];
+    for (i=0; i<n_uni; i++) sum_uni += plan->unit[i];
+    flr = (flr > 0.0 && sum_uni > 0.0) ? flr/n_tgt/sum_uni 
+      : EPSILON*offset_time;
+    for (i=hn_uni; i<n_all-hn_uni; i++)
+    {
+      if (dwelltime[i] < offset_time + flr) 
+      {
+        dwelltime[i] = offset_time + flr;
+      }
+    }
+    if (dwell_prv != NULL)
+    {
+      memcpy(dwell_prv, dwelltime, sizeof(double)*n_all);
+      InitVectorToDblZero(n_all, rl_stp);
+    }
+  }
+  sol->rms_bef = sol->rms_aft;
+  sol->rms_aft = ConvoluteErrors(plan, dwelltime, target, 
+      real_fig, sol->error);
+  if (dwell_prv != NULL && sol->n_step > 0 
+      && sol->rms_aft > sol->rms_bef)
+  {
+    // restart the extrapolation from the next step
+    InitVectorToDblZero(n_all, rl_stp);
+    sol->n_rst++;
+  }
+  // the ratio of the target to the figure
+#pragma omp parallel for default(none)  \
+  private(i,fig)                        \
+  shared(n_tgt,n_uni,target,real_fig,ratio)
+  for (i=0; i<n_tgt; i++)
+  {
+    fig      = real_fig[i+n_uni];
+    ratio[i] = (fig <= 0.0) ? 1.0 
+      : (target[i] > 0.0) ? target[i]/fig : 0.0;
+  }
+  CorrelateErrors(plan, ratio, update);
+  // the multiplicative update, and its step kept for STEP_RLACC
+#pragma omp parallel for default(none)  \
+  private(i,x)                          \
+  shared(n_all,hn_uni,offset_time,update,rl_nrm,dwelltime, \
+    dwell_trl,dwell_prv,rl_stp)         \
+  reduction(+:dot,sq)
+  for (i=0; i<n_all; i++)
+  {
+    x = dwelltime[i];
+    if (i >= hn_uni && i < n_all-hn_uni && rl_nrm[i] > 0.0)
+    {
+      x = offset_time + (x - offset_time)*update[i]/rl_nrm[i];
+    }
+    if (dwell_prv != NULL)
+    {
+      dot      += (x - dwelltime[i])*rl_stp[i];
+      sq       += rl_stp[i]*rl_stp[i];
+      rl_stp[i] = x - dwelltime[i];
+    }
+    dwell_trl[i] = x;
+  }
+  sol->n_step++;
+  if (dwell_prv == NULL)
+  {
+    tmp = sol->dwelltime;
+    sol->dwelltime = dwell_trl;   sol->dwell_trl = tmp;
+    return 0;
+  }
+  // extrapolate along the last step, as long as it stays 
+  //   above offset_time
+  if (sq > 0.0) acc = dot/sq;
+  if (acc < 0.0)      acc = 0.0;
+  if (acc > RL_ACCEL) acc = RL_ACCEL;
+#pragma omp parallel for default(none)  \
+  private(i,x,y)                        \
+  shared(n_all,acc,offset_time,dwelltime,dwell_trl,dwell_prv)
+  for (i=0; i<n_all; i++)
+  {
+    x = dwell_trl[i];
+    y = x + acc*(x - dwell_prv[i]);
+    dwell_prv[i] = x;
+    dwelltime[i] = (y > offset_time) ? y : x;
+  }
+  sol->alpha = 1.0 + acc;
+  return 0;
+}
+  /**************************************************************
+     Stop the loop when the dwell time no longer changes
+  **************************************************************/
+// the first check at the initial dwell time gives the references
+int InitStopping(ConvPlan *plan, Solver *sol, double rel_tol, 
+    double grd_tol)
+{
+  sol->rel_tol = rel_tol;
+  sol->grd_tol = grd_tol;
+  sol->n_chk   = 0;
+  sol->grd_chk = (double*)AllocateVector(sizeof(double), sol->n_all);
+  CheckConvergence(plan, sol);
+  return 0;
+}
+// the figure and the gradient (err x unit) of the dwell time, 
+//   compared with the RMS N_WINDOW checks before and with the 
+//   gradient of the first check, returning the reason to stop
+int CheckConvergence(ConvPlan *plan, Solver *sol)
+{
+  int    i, k;
+  int    hn_uni = sol->hn_uni, n_all = sol->n_all;
+  double offset_time = sol->offset_time;
+  double rms, rms_old = 0.0, sq_grd = 0.0, sq_prj = 0.0;
+  double *grd = sol->grd_chk, *dwelltime = sol->dwelltime;
+  // the figure of the dwell time replaces that of the solver, 
+  //   which should be the same but for the rounding errors
+  rms = ConvoluteErrors(plan, dwelltime, sol->target, 
+      sol->real_fig, sol->error);
+  CorrelateErrors(plan, sol->error, grd);
+#pragma omp parallel for default(none)  \
+  private(i)                            \
+  shared(n_all,hn_uni,offset_time,dwelltime,grd) \
+  reduction(+:sq_grd,sq_prj)
+  for (i=hn_uni; i<n_all-hn_uni; i++)
+  {
+    sq_grd += grd[i]*grd[i];
+    if (dwelltime[i] > offset_time || grd[i] > 0.0)
+    {
+      sq_prj += grd[i]*grd[i];
+    }
+  }
+  sol->grd_nrm = sqrt(sq_grd);
+  sol->prj_nrm = sqrt(sq_prj);
+  if (sol->n_chk == 0) sol->grd_ref = sol->grd_nrm;
+  k = sol->n_chk % N_WINDOW;
+  if (sol->n_chk >= N_WINDOW) rms_old = sol->rms_win[k];
+  sol->rms_win[k] = rms;
+  sol->n_chk++;
+  if (sol->grd_tol > 0.0 && sol->n_chk > 1)
+  {
+    if (sol->grd_nrm <= sol->grd_tol*sol->grd_ref) return STOP_GRADIENT;
+    if (sol->prj_nrm <= sol->grd_tol*sol->grd_ref) return STOP_PROJECTED;
+  }
+  if (sol->rel_tol > 0.0 && sol->n_chk > N_WINDOW 
+      && rms_old - rms <= sol->rel_tol*rms_old)
+  {
+    return STOP_STALL;
+  }
+  return STOP_NONE;
+}
+int DisplayStopReason(Solver *sol, int stop)
+{
+  switch (stop)
+  {
+    case STOP_THRESHOLD:
+      printf("Stopped: the errors fell below the threshold.\n");
+      break;
+    case STOP_LOOPMAX:
+      printf("Stopped: reached N_LOOPMAX.\n");
+      break;
+    case STOP_STALL:
+      printf("Stopped: the errors were lessened by less than "
+          "rel_tol over %d loops.\n", (int)(N_WINDOW*N_LOOPCHECK));
+      break;
+    case STOP_GRADIENT:
+      printf("Stopped: the gradient fell below grd_tol.\n");
+      break;
+    case STOP_PROJECTED:
+      printf("Stopped: the projected gradient fell below grd_tol "
+          "(optimal with offset_time).\n");
+      break;
+    case STOP_ALPHA:
+      printf("Stopped: a step was rejected with alpha at "
+          "lim_alpha (%e).\n", sol->alpha);
+      break;
+  }
+  if (sol->n_chk > 0)
+  {
+    printf("|gradient|/|initial|: %e, projected: %e\n", 
+        sol->grd_nrm/sol->grd_ref, sol->prj_nrm/sol->grd_ref);
+  }
+  return 0;
+}
+  /**************************************************************
+     Deconvolute the downsampled target in advance
+  **************************************************************/
+// deconvolute the target and the unit downsampled by 2^l 
+//   (l = n_level-1, ..., 1) in turn, each from the dwell time
+//   of the coarser level, and leave the result in sol->dwelltime
+int SolveMultigrid(ConvPlan *plan, Solver *sol, int n_level, 
+    double threshold, double rel_tol, double grd_tol)
+{
+  int    l, f, i, j, d, k, cnt, stop;
+  int    n_tgt = sol->n_tgt, n_uni = sol->n_uni, hn_uni = sol->hn_uni;
+  int    n_tgt_c, n_uni_c, hn_c, n_all_c, n_uni_prv = 0, n_all_prv = 0;
+  double offset_time = sol->offset_time;
+  double *target = sol->target, *unit = plan->unit;
+  double *target_c, *real_fig_c, *error_c, *dwell_c, *update_c;
+  double *unit_c, *dwell_prv = NULL;
+  ConvPlan plan_c;
+  Solver   sol_c;
+  for (l=n_level-1; l>=1; l--)
+  {
+    f       = 1 << l;
+    n_tgt_c = (n_tgt + f - 1) / f;
+    hn_c    = (hn_uni + f - 1) / f;
+    n_uni_c = 2*hn_c + 1;
+    n_all_c = n_tgt_c + 2*N_MARGIN*n_uni_c;
+    if (n_tgt_c < n_uni_c)
+    {
+      printf("Level %d is skipped: too short target.\n", l);
+      continue;
+    }
+    target_c   = (double*)AllocateVector(sizeof(double), n_tgt_c);
+    real_fig_c = (double*)AllocateVector(sizeof(double), n_all_c);
+    error_c    = (double*)AllocateVector(sizeof(double), n_tgt_c);
+    dwell_c    = (double*)AllocateVector(sizeof(double), n_all_c);
+    update_c   = (double*)AllocateVector(sizeof(double), n_all_c);
+    unit_c     = (double*)AllocateVector(sizeof(double), n_uni_c);
+    InitVectorToDblZero(n_tgt_c, target_c  );
+    InitVectorToDblZero(n_all_c, real_fig_c);
+    InitVectorToDblZero(n_tgt_c, error_c   );
+    InitVectorToDblZero(n_all_c, dwell_c   );
+    InitVectorToDblZero(n_all_c, update_c  );
+    InitVectorToDblZero(n_uni_c, unit_c    );
+    // the target averaged over f samples
+    for (k=0; k<n_tgt; k++)
+    {
+      target_c[k/f] += target[k];
+    }
+    for (k=0; k<n_tgt_c; k++)
+    {
+      target_c[k] /= (k < n_tgt/f) ? f : n_tgt%f;
+    }
+    // the unit convoluted with the boxes of f samples on both sides
+    for (j=-hn_c; j<=hn_c; j++)
+    {
+      for (d=1-f; d<f; d++)
+      {
+        i = hn_uni + f*j + d;
+        if (i < 0 || i >= n_uni) continue;
+        unit_c[hn_c+j] += (f - abs(d))*unit[i]/f;
+      }
+    }
+    // the initial dwell time from the coarser level
+    for (i=hn_c; i<n_all_c-hn_c; i++)
+    {
+      dwell_c[i] = offset_time;
+    }
+    if (dwell_prv != NULL)
+    {
+      ProlongDwellTime(n_uni_prv, n_all_prv, dwell_prv, 
+          n_uni_c, hn_c, n_all_c, offset_time, dwell_c);
+      DeallocateVector( dwell_prv );
+    }
+    InitConvPlan(&plan_c, plan->mode, plan->simd, 
+        (plan->mixed == VALID) ? PREC_MIXED : 
+        (plan->single == VALID) ? PREC_SINGLE : PREC_DOUBLE, 
+        n_tgt_c, n_uni_c, hn_c, n_all_c, unit_c);
+    InitSolver(&sol_c, &plan_c, sol->normal_eq, sol->incr_fig, 
+        sol->backtrack, sol->step_mode, sol->restart, sol->n_hist, 
+        sol->n_grow, sol->alpha, sol->ls_alpha, sol->mr_alpha, 
+        sol->lim_alpha, offset_time, target_c, 
+        real_fig_c, error_c, dwell_c, update_c);
+    if (sol->pre != NULL)
+    {
+      InitPrecond(&sol_c, &plan_c, sol->pre_eps);
+    }
+    // the level stops when its own errors no longer change 
+    //   (LEVEL_RTOL, looser than rel_tol of the original level)
+    InitStopping(&plan_c, &sol_c, 
+        (rel_tol > LEVEL_RTOL) ? rel_tol : LEVEL_RTOL, grd_tol);
+    cnt  = 0;
+    stop = STOP_NONE;
+    while (sol_c.rms_bef > threshold*f && cnt < N_LOOPLEVEL 
+        && sol_c.stop == STOP_NONE)
+    {
+      cnt++;
+      IterateDeconvolution(&plan_c, &sol_c, cnt);
+      if (cnt % (int)N_LOOPCHECK == 0 
+          && (stop = CheckConvergence(&plan_c, &sol_c)) != STOP_NONE)
+      {
+        if (SwitchToDouble(&plan_c, "stalled") != VALID) break;
+        sol_c.n_chk = 1;
+        stop = STOP_NONE;
+      }
+    }
+    printf("Level %d (1/%d): loop: %9d, rms: %9.4lf, "
+        "convolutions: %ld\n", l, f, cnt, sol_c.rms_aft, 
+        plan_c.n_conv);
+    if (stop == STOP_NONE && sol_c.stop != STOP_NONE) stop = sol_c.stop;
+    if (stop != STOP_NONE) DisplayStopReason(&sol_c, stop);
+    // keep the dwell time for the finer level; the arrays 
+    //   may have been exchanged with those of the solver
+    dwell_prv = (double*)AllocateVector(sizeof(double), n_all_c);
+    memcpy(dwell_prv, sol_c.dwelltime, sizeof(double)*n_all_c);
+    n_uni_prv = n_uni_c;
+    n_all_prv = n_all_c;
+    DeallocateVector( target_c         );
+    DeallocateVector( sol_c.real_fig   );
+    DeallocateVector( sol_c.error      );
+    DeallocateVector( sol_c.dwelltime  );
+    DeallocateVector( sol_c.update     );
+    DeallocateVector( unit_c           );
+    DeallocateSolver  ( &sol_c  );
+    DeallocateConvPlan( &plan_c );
+  }
+  if (dwell_prv != NULL)
+  {
+    ProlongDwellTime(n_uni_prv, n_all_prv, dwell_prv, 
+        n_uni, hn_uni, sol->n_all, offset_time, sol->dwelltime);
+    DeallocateVector( dwell_prv );
+  }
+  return 0;
+}
+// dwelltime interpolated linearly from dwell_c of the level 
+//   twice as coarse, where the sample k of the target there 
+//   covers the samples 2k and 2k+1
+int ProlongDwellTime(int n_uni_c, int n_all_c, double *dwell_c,
+    int n_uni, int hn_uni, int n_all, double offset_time, 
+    double *dwelltime)
+{
+  int    i, k;
+  double x, w;
+#pragma omp parallel for default(none)  \
+  private(i,k,x,w)                      \
+  shared(n_uni_c,n_all_c,dwell_c,n_uni,hn_uni,n_all,offset_time, \
+    dwelltime)
+  for (i=hn_uni; i<n_all-hn_uni; i++)
+  {
+    x = 0.5*(i - n_uni - 0.5) + n_uni_c;
+    k = (int)floor(x);
+    w = x - k;
+    if (k < 0)
+    {
+      k = 0; w = 0.0;
+    }
+    if (k > n_all_c-2)
+    {
+      k = n_all_c-2; w = 1.0;
+    }
+    dwelltime[i] = (1.0-w)*dwell_c[k] + w*dwell_c[k+1];
+    if (dwelltime[i] < offset_time) dwelltime[i] = offset_time;
+  }
+  return 0;
+}
+  /**************************************************************
+     Convolute the unit sputter yield with the arrays
+  **************************************************************/
+int InitConvPlan(ConvPlan *plan, int mode, int simd, int prec,
+    int n_tgt, int n_uni, int hn_uni, int n_all, double *unit)
+{
+  int i, j, n_hlf, bits, simd_cpu;
+  const char *simd_name[] = {"auto","generic","sse2","avx2","avx512"};
+  if (mode == CONV_AUTO)
+  {
+    mode = ChooseConvMode(simd, prec, n_tgt, n_uni, hn_uni, 
+        n_all, unit);
+  }
+  plan->mode   = mode;
+  plan->n_conv = 0;
+  plan->act    = NULL;
+  plan->n_skip = 0;
+  plan->n_tgt  = n_tgt;
+  plan->n_uni  = n_uni;
+  plan->hn_uni = hn_uni;
+  plan->n_all  = n_all;
+  plan->unit   = unit;
+  plan->n_fft  = 0;
+  plan->bitrev   = NULL;
+  plan->twiddle  = NULL;
+  plan->spc_uni  = NULL;
+  plan->spc_buf  = NULL;
+  plan->real_buf = NULL;
+  plan->autocor  = NULL;
+  plan->spc_nrm  = NULL;
+  plan->fig_mrg  = NULL;
+  plan->cor_mrg  = NULL;
+  plan->nrm      = NULL;
+  plan->mrg      = NULL;
+  plan->unit_rev = NULL;
+  plan->pad_buf  = NULL;
+  plan->single   = INVALID;
+  plan->mixed    = INVALID;
+  plan->fixed    = INVALID;
+  plan->unit_f     = NULL;
+  plan->unit_rev_f = NULL;
+  plan->pad_f      = NULL;
+  plan->correlate_row   = CorrelateRowGeneric;
+  plan->correlate_row_f = CorrelateRowGenericF;
+  plan->n_blk  = N_ROWBLOCK;
+  plan->n_tap  = n_uni;
+  if (mode == CONV_DIRECT)
+  {
+    // choose the vector instructions supported by the CPU
+    simd_cpu = DetectSIMD();
+    if (simd == SIMD_AUTO) simd = simd_cpu;
+    if (simd > simd_cpu)
+    {
+      printf("%s is not supported by this CPU.\n", simd_name[simd]);
+      simd = simd_cpu;
+    }
+#ifdef SIMD_X86
+    if (simd == SIMD_SSE2  ) plan->correlate_row = CorrelateRowSSE2;
+    if (simd == SIMD_AVX2  ) plan->correlate_row = CorrelateRowAVX2;
+    if (simd == SIMD_AVX512) plan->correlate_row = CorrelateRowAVX512;
+    if (simd == SIMD_SSE2  ) plan->correlate_row_f = CorrelateRowSSE2F;
+    if (simd == SIMD_AVX2  ) plan->correlate_row_f = CorrelateRowAVX2F;
+    if (simd == SIMD_AVX512) plan->correlate_row_f = CorrelateRowAVX512F;
+#endif
+    plan->unit_rev = (double*)AllocateVector(sizeof(double), n_uni);
+    for (j=0; j<n_uni; j++)
+    {
+      plan->unit_rev[j] = unit[n_uni-1-j];
+    }
+    if (prec != PREC_DOUBLE)
+    {
+      plan->single     = VALID;
+      plan->mixed      = (prec == PREC_MIXED) ? VALID : INVALID;
+      plan->unit_f     = (float*)AllocateVector(sizeof(float), n_uni);
+      plan->unit_rev_f = (float*)AllocateVector(sizeof(float), n_uni);
+      plan->pad_f      = (float*)AllocateVector(sizeof(float), 
+                           n_all+n_uni);
+      for (j=0; j<n_uni; j++)
+      {
+        plan->unit_f    [j] = (float)unit[j];
+        plan->unit_rev_f[j] = (float)unit[n_uni-1-j];
+      }
+    }
+    InitTileSize(plan);
+#ifdef FIXED_KERNELS
+    // the kernel specialized for n_uni takes all the taps at once
+    for (i=0; fixed_kernels[i].n_uni > 0; i++)
+    {
+      if (fixed_kernels[i].n_uni == n_uni 
+          && fixed_kernels[i].simd == simd)
+      {
+        plan->correlate_row = fixed_kernels[i].correlate_row;
+        plan->fixed = VALID;
+        plan->n_tap = n_uni;
+      }
+    }
+#endif
+  }
+  else if (prec != PREC_DOUBLE)
+  {
+    printf("prec_mode is ignored except in CONV_DIRECT.\n");
+  }
+  plan->simd = simd;
+  if (mode != CONV_FFT)
+  {
+    plan->pad_buf  = (double*)AllocateVector(sizeof(double), 
+                       n_all+n_uni);
+    if (mode != CONV_SEGMENT) return 0;
+  }
+  // the figure spreads over n_all at most, 
+  //   so that a cyclic convolution of n_all does not wrap around
+  plan->n_fft = 4;
+  plan->n_thr = 1;
+  while (plan->n_fft < n_all) plan->n_fft *= 2;
+  if (mode == CONV_SEGMENT) InitSegmentSize(plan);
+  n_hlf = plan->n_fft / 2;
+  plan->bitrev   = (int*)   AllocateVector(sizeof(int), n_hlf);
+  plan->twiddle  = (double*)AllocateVector(sizeof(double), 
+                     plan->n_fft);
+  plan->spc_uni  = (double*)AllocateVector(sizeof(double), 
+                     plan->n_fft+2);
+  plan->spc_buf  = (double*)AllocateVector(sizeof(double), 
+                     (plan->n_fft+2)*plan->n_thr);
+  plan->real_buf = (double*)AllocateVector(sizeof(double), 
+                     plan->n_fft*plan->n_thr);
+  for (bits=0; (1<<bits) < n_hlf; bits++);
+  for (i=0; i<n_hlf; i++)
+  {
+    plan->bitrev[i] = 0;
+    for (j=0; j<bits; j++)
+    {
+      if (i & (1<<j)) plan->bitrev[i] |= 1 << (bits-1-j);
+    }
+    plan->twiddle[2*i  ] =  cos(2.0*M_PI*i/plan->n_fft);
+    plan->twiddle[2*i+1] = -sin(2.0*M_PI*i/plan->n_fft);
+  }
+  // center the unit on the origin of the cyclic array
+  //   and scale it to omit the normalization of the inverse
+  InitVectorToDblZero(plan->n_fft, plan->real_buf);
+  for (j=0; j<n_uni; j++)
+  {
+    plan->real_buf[(j-hn_uni+plan->n_fft) % plan->n_fft] 
+      = unit[j] / plan->n_fft;
+  }
+  TransformRealFFT(plan, plan->real_buf, plan->spc_uni);
+  return 0;
+}
+// time CONV_DIRECT, CONV_FFT and CONV_SEGMENT for a loop, 
+//   and return the fastest one
+int ChooseConvMode(int simd, int prec, int n_tgt, int n_uni, 
+    int hn_uni, int n_all, double *unit)
+{
+  int      i, k, mode, rep, best = CONV_FFT;
+  const int modes[] = {CONV_DIRECT, CONV_FFT, CONV_SEGMENT};
+  double   st, tm, tm_best = 0.0;
+  double   *dwelltime, *real_fig, *scratch;
+  ConvPlan plan;
+  dwelltime = (double*)AllocateVector(sizeof(double), n_all);
+  real_fig  = (double*)AllocateVector(sizeof(double), n_all);
+  scratch   = (double*)AllocateVector(sizeof(double), n_all);
+  // the same input in every repetition, so that the values 
+  //   never drift toward the denormals and slow a backend down
+  for (i=0; i<n_all; i++) dwelltime[i] = 1.0;
+  for (k=0; k<3; k++)
+  {
+    mode = modes[k];
+    InitConvPlan(&plan, mode, simd, 
+        (mode == CONV_DIRECT) ? prec : PREC_DOUBLE, 
+        n_tgt, n_uni, hn_uni, n_all, unit);
+    // repeat it for 10 ms at least to average the noise
+    st = omp_get_wtime();
+    for (rep=1; ; rep++)
+    {
+      ConvoluteFigure(&plan, dwelltime, real_fig);
+      CorrelateErrors(&plan, real_fig, scratch);
+      if ((tm = omp_get_wtime() - st) > 0.01) break;
+    }
+    tm /= rep;
+    if (mode == CONV_DIRECT || tm < tm_best)
+    {
+      best = mode; tm_best = tm;
+    }
+    DeallocateConvPlan(&plan);
+  }
+  DeallocateVector( dwelltime );
+  DeallocateVector( real_fig  );
+  DeallocateVector( scratch   );
+  return best;
+}
+// PREC_MIXED leaves the float kernels for good, 
+//   returning INVALID unless running in float
+int SwitchToDouble(ConvPlan *plan, const char *reason)
+{
+  if (plan->mixed != VALID) return INVALID;
+  plan->single = INVALID;
+  plan->mixed  = INVALID;
+  printf("Switched to double precision (%s)\n", reason);
+  return VALID;
+}
+int DisplayConvPlan(ConvPlan *plan)
+{
+  const char *simd_name[] = {"auto","generic","sse2","avx2","avx512"};
+  if (plan->mode == CONV_DIRECT)
+  {
+    printf("Convolution: direct (%s%s, %s, tiles of %d x %d)\n", 
+        simd_name[plan->simd], 
+        (plan->fixed == VALID) ? " fixed" : "",
+        (plan->single == VALID) ? "float" : "double",
+        plan->n_blk, plan->n_tap);
+  }
+  if (plan->mode == CONV_SCATTER) printf("Convolution: scatter\n");
+  if (plan->mode == CONV_FFT)
+  {
+    printf("Convolution: FFT (%d points)\n", plan->n_fft);
+  }
+  if (plan->mode == CONV_SEGMENT)
+  {
+    printf("Convolution: segments of %d points (%d threads)\n", 
+        plan->n_fft, plan->n_thr);
+  }
+  return 0;
+}
+void DeallocateConvPlan(ConvPlan *plan)
+{
+  if (plan->autocor != NULL)
+  {
+    DeallocateVector( plan->autocor );
+    DeallocateVector( plan->fig_mrg );
+    DeallocateVector( plan->cor_mrg );
+  }
+  if (plan->nrm != NULL)
+  {
+    DeallocateConvPlan( plan->nrm );
+    free( plan->nrm );
+  }
+  if (plan->mrg != NULL)
+  {
+    DeallocateConvPlan( plan->mrg );
+    free( plan->mrg );
+  }
+  if (plan->spc_nrm != NULL) DeallocateVector( plan->spc_nrm );
+  if (plan->unit_rev != NULL) DeallocateVector( plan->unit_rev );
+  if (plan->unit_f   != NULL)
+  {
+    free( plan->unit_f     );
+    free( plan->unit_rev_f );
+    free( plan->pad_f      );
+  }
+  if (plan->pad_buf  != NULL) DeallocateVector( plan->pad_buf  );
+  if (plan->bitrev == NULL) return;
+  free( plan->bitrev );
+  DeallocateVector( plan->twiddle  );
+  DeallocateVector( plan->spc_uni  );
+  DeallocateVector( plan->spc_buf  );
+  DeallocateVector( plan->real_buf );
+}
+// real_fig[k] = sum_j unit[j]*dwelltime[k+hn_uni-j]
+int ConvoluteFigure(ConvPlan *plan, double *dwelltime, 
+    double *real_fig)
+{
+  plan->n_conv++;
+  if (plan->mode == CONV_FFT)
+  {
+    return ConvoluteFFT(plan, dwelltime, real_fig);
+  }
+  if (plan->mode == CONV_SCATTER)
+  {
+    return ConvoluteScatter(plan, dwelltime, real_fig);
+  }
+  if (plan->mode == CONV_SEGMENT)
+  {
+    return ConvoluteSegments(plan, dwelltime, real_fig);
+  }
+  return ConvoluteDirect(plan, dwelltime, real_fig);
+}
+// the figure and the errors in one pass, returning the RMS;
+//   each block of the figure is compared with the target 
+//   while it stays in the cache
+double ConvoluteErrors(ConvPlan *plan, double *dwelltime, 
+    double *target, double *real_fig, double *error)
+{
+  int    k, m, lo, hi, len;
+  int    n_tgt = plan->n_tgt, n_uni = plan->n_uni;
+  int    hn_uni = plan->hn_uni, n_all = plan->n_all;
+  double rms = 0.0;
+  double *x = plan->pad_buf;
+  if (plan->mode == CONV_SCATTER || plan->mode == CONV_SEGMENT)
+  {
+    ConvoluteFigure(plan, dwelltime, real_fig);
+    return CalcErrors(n_tgt, n_uni, target, real_fig, error);
+  }
+  plan->n_conv++;
+  if (plan->mode == CONV_FFT)
+  {
+    ConvoluteSpectra(plan, dwelltime);
+    x = plan->real_buf;
+    memcpy(real_fig, x, sizeof(double)*n_uni);
+    memcpy(real_fig+n_uni+n_tgt, x+n_uni+n_tgt, 
+        sizeof(double)*(n_all-n_uni-n_tgt));
+#pragma omp parallel for default(none) \
+    private(k)                         \
+    shared(n_tgt,n_uni,x,target,real_fig,error) \
+    reduction(+:rms)
+    for (k=0; k<n_tgt; k++)
+    {
+      real_fig[k+n_uni] = x[k+n_uni];
+      error[k] = target[k] - x[k+n_uni];
+      rms     += error[k]*error[k];
+    }
+    return sqrt( rms/n_tgt );
+  }
+  PadArray(plan, dwelltime+hn_uni, 2*hn_uni, n_all-2*hn_uni);
+#pragma omp parallel for default(none)  \
+  private(k,m,lo,hi,len)                \
+  shared(plan,n_tgt,n_uni,n_all,target,real_fig,error) \
+  reduction(+:rms)
+  for (k=0; k<n_all; k+=plan->n_blk)
+  {
+    len = (n_all-k < plan->n_blk) ? n_all-k : plan->n_blk;
+    CorrelateTile(plan, VALID, k, real_fig+k, len);
+    lo  = (k > n_uni) ? k : n_uni;
+    hi  = (k+len < n_uni+n_tgt) ? k+len : n_uni+n_tgt;
+    for (m=lo; m<hi; m++)
+    {
+      error[m-n_uni] = target[m-n_uni] - real_fig[m];
+      rms += error[m-n_uni]*error[m-n_uni];
+    }
+  }
+  return sqrt( rms/n_tgt );
+}
+// update[i] = sum_j unit[j]*error[i-hn_uni+j-n_uni], 
+//   which is the transpose of ConvoluteFigure
+int CorrelateErrors(ConvPlan *plan, double *error, 
+    double *update)
+{
+  plan->n_conv++;
+  if (plan->mode == CONV_FFT)
+  {
+    return CorrelateFFT(plan, error, update);
+  }
+  if (plan->mode == CONV_SCATTER)
+  {
+    return CorrelateScatter(plan, error, update);
+  }
+  if (plan->mode == CONV_SEGMENT)
+  {
+    return CorrelateSegments(plan, error, update);
+  }
+  return CorrelateDirect(plan, error, update);
+}
+// dwelltime += alpha*(err x unit), limited by offset_time,
+//   without storing the update in an array of n_all
+int CorrelateUpdate(ConvPlan *plan, double *error, 
+    double alpha, double offset_time, double *dwelltime)
+{
+  int    i, k, len;
+  int    n_tgt = plan->n_tgt, n_uni = plan->n_uni;
+  int    hn_uni = plan->hn_uni, n_all = plan->n_all;
+  double upd[N_ROWBLOCK];
+  double *x = plan->pad_buf;
+  if (plan->mode != CONV_DIRECT)
+  {
+    if (plan->mode == CONV_FFT)
+    {
+      CorrelateSpectra(plan, error);
+      x = plan->real_buf;
+      plan->n_conv++;
+    }
+    else
+    {
+      CorrelateErrors(plan, error, x);
+    }
+#pragma omp parallel for default(none) \
+    private(i)                         \
+    shared(n_all,hn_uni,alpha,offset_time,x,dwelltime)
+    for (i=hn_uni; i<n_all-hn_uni; i++)
+    {
+      dwelltime[i] += alpha*x[i];
+      if (dwelltime[i] < offset_time) dwelltime[i] = offset_time;
+    }
+    return 0;
+  }
+  // x[k] = error[k-hn_uni-n_uni]
+  plan->n_conv++;
+  PadArray(plan, error, hn_uni+n_uni, n_tgt);
+#pragma omp parallel for default(none)  \
+  private(i,k,len,upd)                  \
+  shared(plan,hn_uni,n_all,alpha,offset_time,dwelltime)
+  for (k=hn_uni; k<n_all-hn_uni; k+=plan->n_blk)
+  {
+    len = (n_all-hn_uni-k < plan->n_blk) ? 
+      n_all-hn_uni-k : plan->n_blk;
+    if (plan->act != NULL)
+    {
+      // the rows of the active set stay at offset_time
+      memset(upd, 0, sizeof(double)*len);
+      CorrelateFreeRows(plan, k, upd, len);
+    }
+    else
+    {
+      CorrelateTile(plan, INVALID, k, upd, len);
+    }
+    for (i=0; i<len; i++)
+    {
+      dwelltime[k+i] += alpha*upd[i];
+      if (dwelltime[k+i] < offset_time) dwelltime[k+i] = offset_time;
+    }
+  }
+  return 0;
+}
+int ConvoluteDirect(ConvPlan *plan, double *dwelltime, 
+    double *real_fig)
+{
+  int    hn_uni = plan->hn_uni, n_all = plan->n_all;
+  // real_fig[k] = sum_j unit_rev[j]*x[k+j], x[k] = dwelltime[k-hn_uni]
+  PadArray(plan, dwelltime+hn_uni, 2*hn_uni, n_all-2*hn_uni);
+  CorrelateRows(plan, VALID, 0, real_fig, n_all);
+  return 0;
+}
+int CorrelateDirect(ConvPlan *plan, double *error, 
+    double *update)
+{
+  int    hn_uni = plan->hn_uni, n_all = plan->n_all;
+  // update[i] = sum_j unit[j]*x[i+j], x[k] = error[k-hn_uni-n_uni]
+  PadArray(plan, error, hn_uni+plan->n_uni, plan->n_tgt);
+  memset(update, 0, sizeof(double)*n_all);
+  if (plan->act != NULL)
+  {
+    return CorrelateFreeRows(plan, hn_uni, update+hn_uni, 
+        n_all-2*hn_uni);
+  }
+  CorrelateRows(plan, INVALID, hn_uni, update+hn_uni, 
+      n_all-2*hn_uni);
+  return 0;
+}
+int ConvoluteScatter(ConvPlan *plan, double *dwelltime, 
+    double *real_fig)
+{
+  int    i, j, tmp;
+  int    n_uni = plan->n_uni, hn_uni = plan->hn_uni;
+  int    n_all = plan->n_all;
+  double *unit = plan->unit;
+  InitVectorToDblZero(n_all, real_fig);
+#pragma omp parallel for default(none) \
+  private(i,j,tmp)\
+  shared(n_all, n_uni,hn_uni,dwelltime,unit)\
+  reduction(+:real_fig[:n_all])
+  for (i=hn_uni; i<n_all-hn_uni; i++)
+  {
+    for (j=0; j<n_uni; j++)
+    {
+      tmp            = i - hn_uni + j;
+      real_fig[tmp] += (dwelltime[i]*unit[j]);
+    }
+  }
+  return 0;
+}
+int CorrelateScatter(ConvPlan *plan, double *error, 
+    double *update)
+{
+  int    i, j, tmp;
+  int    n_tgt = plan->n_tgt, n_uni = plan->n_uni;
+  int    hn_uni = plan->hn_uni, n_all = plan->n_all;
+  double *unit = plan->unit;
+  InitVectorToDblZero(n_all, update);
+#pragma omp parallel for default(none) \
+  private(i,j,tmp)\
+  shared(n_tgt, n_uni, hn_uni,error,unit)\
+  reduction(+:update[:n_all])
+  for (i=0; i<n_tgt; i++)
+  {
+    for (j=0; j<n_uni; j++)
+    {
+      tmp = i + n_uni + hn_uni - j;
+      update[tmp] += (error[i]*unit[j]);
+    }
+  }
+  return 0;
+}
+int ConvoluteFFT(ConvPlan *plan, double *dwelltime, 
+    double *real_fig)
+{
+  ConvoluteSpectra(plan, dwelltime);
+  memcpy(real_fig, plan->real_buf, sizeof(double)*plan->n_all);
+  return 0;
+}
+// the figure is left in real_buf
+int ConvoluteSpectra(ConvPlan *plan, double *dwelltime)
+{
+  int    i;
+  int    n_hlf = plan->n_fft/2, hn_uni = plan->hn_uni;
+  double re, im;
+  double *x = plan->real_buf, *s = plan->spc_buf;
+  double *u = plan->spc_uni;
+  InitVectorToDblZero(plan->n_fft, x);
+  for (i=hn_uni; i<plan->n_all-hn_uni; i++)
+  {
+    x[i] = dwelltime[i];
+  }
+  TransformRealFFT(plan, x, s);
+  for (i=0; i<=n_hlf; i++)
+  {
+    re = s[2*i]*u[2*i  ] - s[2*i+1]*u[2*i+1];
+    im = s[2*i]*u[2*i+1] + s[2*i+1]*u[2*i  ];
+    s[2*i] = re; s[2*i+1] = im;
+  }
+  InverseRealFFT(plan, s, x);
+  return 0;
+}
+int CorrelateFFT(ConvPlan *plan, double *error, 
+    double *update)
+{
+  CorrelateSpectra(plan, error);
+  memcpy(update, plan->real_buf, sizeof(double)*plan->n_all);
+  return 0;
+}
+// the update is left in real_buf
+int CorrelateSpectra(ConvPlan *plan, double *error)
+{
+  int    i;
+  int    n_hlf = plan->n_fft/2, n_uni = plan->n_uni;
+  double re, im;
+  double *x = plan->real_buf, *s = plan->spc_buf;
+  double *u = plan->spc_uni;
+  InitVectorToDblZero(plan->n_fft, x);
+  for (i=0; i<plan->n_tgt; i++)
+  {
+    x[i+n_uni] = error[i];
+  }
+  TransformRealFFT(plan, x, s);
+  // multiply by the complex conjugate to correlate
+  for (i=0; i<=n_hlf; i++)
+  {
+    re = s[2*i]*u[2*i  ] + s[2*i+1]*u[2*i+1];
+    im = s[2*i+1]*u[2*i] - s[2*i  ]*u[2*i+1];
+    s[2*i] = re; s[2*i+1] = im;
+  }
+  InverseRealFFT(plan, s, x);
+  return 0;
+}
+// segments of the L2 cache, which are four times as long 
+//   as the unit at least so that the overlaps cost less
+int InitSegmentSize(ConvPlan *plan)
+{
+  int  n_seg = 4;
+  long l2 = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+  if (l2 <= 0) l2 = 262144;
+  // a real array and its spectrum fill a half of the L2 cache
+  while ((long)(2*n_seg)*2*sizeof(double) <= l2/2) n_seg *= 2;
+  while (n_seg < 4*plan->n_uni) n_seg *= 2;
+  if (n_seg < plan->n_fft) plan->n_fft = n_seg;
+  plan->n_thr = omp_get_max_threads();
+  return 0;
+}
+int ConvoluteSegments(ConvPlan *plan, double *dwelltime, 
+    double *real_fig)
+{
+  int hn_uni = plan->hn_uni, n_all = plan->n_all;
+  return SegmentConvolution(plan, plan->spc_uni, plan->n_uni, 
+      hn_uni, SPC_CONV, dwelltime+hn_uni, hn_uni, n_all-2*hn_uni, 
+      real_fig, 0, n_all);
+}
+int CorrelateSegments(ConvPlan *plan, double *error, 
+    double *update)
+{
+  int hn_uni = plan->hn_uni, n_all = plan->n_all;
+  memset(update, 0, sizeof(double)*hn_uni);
+  memset(update+n_all-hn_uni, 0, sizeof(double)*hn_uni);
+  return SegmentConvolution(plan, plan->spc_uni, plan->n_uni, 
+      hn_uni, SPC_CORR, error, plan->n_uni, plan->n_tgt, 
+      update, hn_uni, n_all-hn_uni);
+}
+// overlap-save of a kernel h[n_k] centered on hn_k, 
+//   y[k] = sum_j h[j]*x[k+hn_k-j]  (SPC_CONV, SPC_REAL)
+//   y[k] = sum_j h[j]*x[k-hn_k+j]  (SPC_CORR)
+//   for y_lo <= k < y_hi, where x[m] = src[m-x_off] 
+//   (zero out of 0 <= m-x_off < n_src).
+//   spc is the spectrum of h for n_fft (SPC_REAL: real numbers),
+//   and each segment gives n_fft-n_k+1 elements of y
+int SegmentConvolution(ConvPlan *plan, const double *spc, 
+    int n_k, int hn_k, int type, const double *src, 
+    int x_off, int n_src, double *y, int y_lo, int y_hi)
+{
+  int    i, g, n_grp, lo, len, st, en, thr;
+  int    n_fft = plan->n_fft, n_hlf = n_fft/2;
+  int    n_val = n_fft-n_k+1;
+  double re, im;
+  double *x, *s;
+  // the first element of a segment without wrapping around
+  lo    = (type == SPC_CORR) ? hn_k : n_k-1-hn_k;
+  n_grp = (y_hi-y_lo + n_val-1) / n_val;
+#pragma omp parallel for default(none)          \
+  private(i,g,len,st,en,thr,re,im,x,s)          \
+  shared(plan,spc,type,src,x_off,n_src,y,y_lo,y_hi, \
+    n_fft,n_hlf,n_val,lo,n_grp)
+  for (g=0; g<n_grp; g++)
+  {
+    thr = omp_get_thread_num();
+    x   = plan->real_buf + (size_t)thr*n_fft;
+    s   = plan->spc_buf  + (size_t)thr*(n_fft+2);
+    // x[i] = src[y_lo+g*n_val-lo+i-x_off] within src
+    st  = y_lo + g*n_val - lo - x_off;
+    en  = st + n_fft;
+    memset(x, 0, sizeof(double)*n_fft);
+    if (st < 0    ) st = 0;
+    if (en > n_src) en = n_src;
+    if (st < en)
+    {
+      memcpy(x + st-(y_lo+g*n_val-lo-x_off), src+st, 
+          sizeof(double)*(en-st));
+    }
+    TransformRealFFT(plan, x, s);
+    for (i=0; i<=n_hlf; i++)
+    {
+      if (type == SPC_REAL)
+      {
+        s[2*i] *= spc[i]; s[2*i+1] *= spc[i];
+        continue;
+      }
+      if (type == SPC_CORR)
+      {
+        re = s[2*i]*spc[2*i  ] + s[2*i+1]*spc[2*i+1];
+        im = s[2*i+1]*spc[2*i] - s[2*i  ]*spc[2*i+1];
+      }
+      else
+      {
+        re = s[2*i]*spc[2*i  ] - s[2*i+1]*spc[2*i+1];
+        im = s[2*i]*spc[2*i+1] + s[2*i+1]*spc[2*i  ];
+      }
+      s[2*i] = re; s[2*i+1] = im;
+    }
+    InverseRealFFT(plan, s, x);
+    len = (y_hi-y_lo-g*n_val < n_val) ? y_hi-y_lo-g*n_val : n_val;
+    memcpy(y+y_lo+g*n_val, x+lo, sizeof(double)*len);
+  }
+  return 0;
+}
+// autocorrelation of the unit for the normal equation, 
+//   and the tiled kernels to apply it and to correct the margins
+int InitNormalPlan(ConvPlan *plan)
+{
+  int    i, j, m;
+  int    n_uni = plan->n_uni, n_hlf = plan->n_fft/2;
+  int    n_tgt = plan->n_tgt, n_all = plan->n_all;
+  double sum;
+  double *unit = plan->unit, *u = plan->spc_uni;
+  plan->autocor = (double*)AllocateVector(sizeof(double), 
+                    2*n_uni-1);
+  plan->fig_mrg = (double*)AllocateVector(sizeof(double), n_all);
+  plan->cor_mrg = (double*)AllocateVector(sizeof(double), n_all);
+  InitVectorToDblZero(n_all, plan->fig_mrg);
+  for (m=0; m<n_uni; m++)
+  {
+    sum = 0.0;
+    for (j=0; j+m<n_uni; j++) sum += unit[j]*unit[j+m];
+    plan->autocor[n_uni-1+m] = sum;
+    plan->autocor[n_uni-1-m] = sum;
+  }
+  // in double precision, since the RMS from the inner products 
+  //   cancels out in float
+  if (plan->single == VALID)
+  {
+    printf("prec_mode is ignored with normal_eq.\n");
+  }
+  if (plan->mode == CONV_DIRECT)
+  {
+    // autocor is another unit of 2*n_uni-1 centered on n_uni-1
+    plan->nrm = (ConvPlan*)AllocateVector(sizeof(ConvPlan), 1);
+    InitConvPlan(plan->nrm, CONV_DIRECT, plan->simd, PREC_DOUBLE, 
+        n_tgt, 2*n_uni-1, n_uni-1, n_all, plan->autocor);
+  }
+  // the margins are convoluted directly even with the FFT
+  plan->mrg = (ConvPlan*)AllocateVector(sizeof(ConvPlan), 1);
+  InitConvPlan(plan->mrg, CONV_DIRECT, plan->simd, PREC_DOUBLE, 
+      n_tgt, n_uni, plan->hn_uni, n_all, unit);
+  if (plan->mode == CONV_FFT || plan->mode == CONV_SEGMENT)
+  {
+    // |spc_uni|^2 is scaled by 1/n_fft^2, and should be 1/n_fft
+    plan->spc_nrm = (double*)AllocateVector(sizeof(double), 
+                      n_hlf+1);
+    for (i=0; i<=n_hlf; i++)
+    {
+      plan->spc_nrm[i] = (u[2*i]*u[2*i] + u[2*i+1]*u[2*i+1])
+        * plan->n_fft;
+    }
+  }
+  return 0;
+}
+// normal = (unit x unit x dwelltime) only within the target
+int ApplyNormal(ConvPlan *plan, double *dwelltime, 
+    double *normal)
+{
+  plan->n_conv++;
+  if (plan->mode == CONV_FFT)
+  {
+    NormalFFT(plan, dwelltime, normal);
+  }
+  else if (plan->mode == CONV_SEGMENT)
+  {
+    NormalSegments(plan, dwelltime, normal);
+  }
+  else
+  {
+    NormalDirect(plan, dwelltime, normal);
+  }
+  return SubtractMargins(plan, dwelltime, normal);
+}
+int NormalDirect(ConvPlan *plan, double *dwelltime, 
+    double *normal)
+{
+  int      n_uni = plan->n_uni, hn_uni = plan->hn_uni;
+  int      n_all = plan->n_all;
+  ConvPlan *nrm = plan->nrm;
+  // normal[i] = sum_j autocor[j]*x[i-hn_uni+j], 
+  //   x[k] = dwelltime[k+hn_uni-(n_uni-1)]
+  PadArray(nrm, dwelltime+hn_uni, n_uni-1, n_all-2*hn_uni);
+  memset(normal, 0, sizeof(double)*hn_uni);
+  memset(normal+n_all-hn_uni, 0, sizeof(double)*hn_uni);
+  return CorrelateRows(nrm, INVALID, 0, normal+hn_uni, 
+      n_all-2*hn_uni);
+}
+int NormalFFT(ConvPlan *plan, double *dwelltime, 
+    double *normal)
+{
+  int    i;
+  int    n_hlf = plan->n_fft/2, hn_uni = plan->hn_uni;
+  double *x = plan->real_buf, *s = plan->spc_buf;
+  InitVectorToDblZero(plan->n_fft, x);
+  for (i=hn_uni; i<plan->n_all-hn_uni; i++)
+  {
+    x[i] = dwelltime[i];
+  }
+  TransformRealFFT(plan, x, s);
+  for (i=0; i<=n_hlf; i++)
+  {
+    s[2*i  ] *= plan->spc_nrm[i];
+    s[2*i+1] *= plan->spc_nrm[i];
+  }
+  InverseRealFFT(plan, s, x);
+  memcpy(normal, x, sizeof(double)*plan->n_all);
+  return 0;
+}
+// (unit x unit) spreads over 2*n_uni-1 centered on n_uni-1
+int NormalSegments(ConvPlan *plan, double *dwelltime, 
+    double *normal)
+{
+  int hn_uni = plan->hn_uni, n_all = plan->n_all;
+  memset(normal, 0, sizeof(double)*hn_uni);
+  memset(normal+n_all-hn_uni, 0, sizeof(double)*hn_uni);
+  return SegmentConvolution(plan, plan->spc_nrm, 2*plan->n_uni-1,
+      plan->n_uni-1, SPC_REAL, dwelltime+hn_uni, hn_uni, 
+      n_all-2*hn_uni, normal, hn_uni, n_all-hn_uni);
+}
+// remove what the figure out of the target adds to (unit x unit),
+//   convoluting only the rows of the margins and correlating them 
+//   only near the both ends with the tiled kernels
+int SubtractMargins(ConvPlan *plan, double *dwelltime, 
+    double *normal)
+{
+  int      i, n_lft, n_rgt, s_rgt;
+  int      n_tgt = plan->n_tgt, n_uni = plan->n_uni;
+  int      hn_uni = plan->hn_uni, n_all = plan->n_all;
+  double   *fig = plan->fig_mrg, *cor = plan->cor_mrg;
+  ConvPlan *mrg = plan->mrg;
+  // the figure in the margins, [0,n_uni) and [n_uni+n_tgt,n_all),
+  //   as in ConvoluteDirect; the rest of fig stays zero
+  PadArray(mrg, dwelltime+hn_uni, 2*hn_uni, n_all-2*hn_uni);
+  CorrelateRows(mrg, VALID, 0, fig, n_uni);
+  CorrelateRows(mrg, VALID, n_uni+n_tgt, fig+n_uni+n_tgt, 
+      n_all-n_uni-n_tgt);
+  // correlate them with the unit near the both ends,
+  //   [hn_uni,n_uni+hn_uni) and [n_tgt+hn_uni+1,n_all-hn_uni),
+  //   as in CorrelateUpdate, x[k] = fig[k-hn_uni]
+  n_lft = (n_uni+hn_uni < n_all-hn_uni) ? n_uni : n_all-2*hn_uni;
+  s_rgt = (n_tgt+1 > n_uni) ? n_tgt+hn_uni+1 : n_uni+hn_uni;
+  n_rgt = (n_all-hn_uni > s_rgt) ? n_all-hn_uni-s_rgt : 0;
+  PadArray(mrg, fig, hn_uni, n_all);
+  CorrelateRows(mrg, INVALID, hn_uni, cor, n_lft);
+  CorrelateRows(mrg, INVALID, s_rgt, cor+n_lft, n_rgt);
+  for (i=0; i<n_lft; i++) normal[hn_uni+i] -= cor[i];
+  for (i=0; i<n_rgt; i++) normal[s_rgt+i]  -= cor[n_lft+i];
+  return 0;
+}
+  /**************************************************************
+     Vectorized kernels, y[k] = sum_j u[j]*x[k+j]
+  **************************************************************/
+int DetectSIMD(void)
+{
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2") && 
+      __builtin_cpu_supports("fma")) return SIMD_AVX2;
+  if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+  return SIMD_GENERIC;
+}
+// n_blk rows and n_tap taps of a tile, the window of x (n_blk+n_tap)
+//   and the sums (n_blk) fill a half of the L1 cache
+int InitTileSize(ConvPlan *plan)
+{
+  long l1 = -1;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+#endif
+  if (l1 <= 0) l1 = 32768;
+  l1 /= 2*sizeof(double);
+  // rows in multiples of 32 and taps in multiples of 8
+  plan->n_blk = (int)(l1/4) / 32 * 32;
+  if (plan->n_blk < 32        ) plan->n_blk = 32;
+  if (plan->n_blk > N_ROWBLOCK) plan->n_blk = N_ROWBLOCK;
+  plan->n_tap = (int)(l1 - 2*plan->n_blk) / 2 / 8 * 8;
+  if (plan->n_tap < 8) plan->n_tap = 8;
+  return 0;
+}
+// pad_buf[off+i] = src[i] (i<n) padded with zeros to n_all+n_uni,
+//   in float while the float kernels are used
+void PadArray(ConvPlan *plan, const double *src, int off, int n)
+{
+  int i, n_pad = plan->n_all + plan->n_uni;
+  if (plan->single == VALID)
+  {
+    memset(plan->pad_f, 0, sizeof(float)*n_pad);
+    for (i=0; i<n; i++) plan->pad_f[off+i] = (float)src[i];
+    return;
+  }
+  memset(plan->pad_buf, 0, sizeof(double)*n_pad);
+  memcpy(plan->pad_buf+off, src, sizeof(double)*n);
+}
+// y[i] = sum_j u[j]*pad_buf[k+i+j] (i < n_y <= N_ROWBLOCK)
+//   with u = unit_rev (rev is VALID) or unit,
+//   summing up the tiles of n_tap taps in double
+void CorrelateTile(ConvPlan *plan, int rev, int k, 
+    double *y, int n_y)
+{
+  int    i, j, len, n_u = plan->n_uni;
+  double sum[N_ROWBLOCK];
+  float  sum_f[N_ROWBLOCK];
+  const double *u;
+  const float  *u_f;
+  for (j=0; j<n_u; j+=len)
+  {
+    len = (n_u-j < plan->n_tap) ? n_u-j : plan->n_tap;
+    if (plan->single == VALID)
+    {
+      u_f = (rev == VALID) ? plan->unit_rev_f : plan->unit_f;
+      plan->correlate_row_f(u_f+j, len, plan->pad_f+k+j, sum_f, n_y);
+      for (i=0; i<n_y; i++) sum[i] = sum_f[i];
+    }
+    else
+    {
+      u = (rev == VALID) ? plan->unit_rev : plan->unit;
+      plan->correlate_row(u+j, len, plan->pad_buf+k+j, sum, n_y);
+    }
+    if (j == 0)
+    {
+      memcpy(y, sum, sizeof(double)*n_y);
+      continue;
+    }
+    for (i=0; i<n_y; i++) y[i] += sum[i];
+  }
+}
+// y[i] = sum_j u[j]*pad_buf[k+i+j] only for the runs of rows 
+//   out of plan->act, leaving y of the others as they are; 
+//   the tiles are shared among the threads unless in one tile
+int CorrelateFreeRows(ConvPlan *plan, int k, double *y, int n_y)
+{
+  int  i, st, en, len;
+  long n_skip = 0;
+  const char *act = plan->act;
+#pragma omp parallel for default(none) \
+  private(i,st,en,len)                 \
+  shared(plan,act,k,y,n_y)             \
+  reduction(+:n_skip)                  \
+  if(n_y > plan->n_blk)
+  for (i=0; i<n_y; i+=plan->n_blk)
+  {
+    len = (n_y-i < plan->n_blk) ? n_y-i : plan->n_blk;
+    for (st=0; st<len; st=en)
+    {
+      for (; st<len && act[k+i+st] == VALID; st++) n_skip++;
+      for (en=st; en<len && act[k+i+en] != VALID; en++);
+      if (en > st) CorrelateTile(plan, INVALID, k+i+st, y+i+st, en-st);
+    }
+  }
+#pragma omp atomic
+  plan->n_skip += n_skip;
+  return 0;
+}
+// y[i] = sum_j u[j]*pad_buf[k+i+j] (i < n_y), 
+//   sharing the tiles of rows among the threads
+int CorrelateRows(ConvPlan *plan, int rev, int k, 
+    double *y, int n_y)
+{
+  int i, len;
+#pragma omp parallel for default(none) \
+  private(i,len)                       \
+  shared(plan,rev,k,y,n_y)
+  for (i=0; i<n_y; i+=plan->n_blk)
+  {
+    len = (n_y-i < plan->n_blk) ? n_y-i : plan->n_blk;
+    CorrelateTile(plan, rev, k+i, y+i, len);
+  }
+  return 0;
+}
+void CorrelateRowGeneric(const double *u, int n_u, 
+    const double *x, double *y, int n_y)
+{
+  int    j, k;
+  double sum;
+  for (k=0; k<n_y; k++)
+  {
+    sum = 0.0;
+#pragma omp simd reduction(+:sum)
+    for (j=0; j<n_u; j++)
+    {
+      sum += u[j]*x[k+j];
+    }
+    y[k] = sum;
+  }
+}
+#ifdef SIMD_X86
+// each vector holds successive elements of y,
+//   and four vectors are accumulated at once to hide the latency
+__attribute__((target("sse2")))
+void CorrelateRowSSE2(const double *u, int n_u, 
+    const double *x, double *y, int n_y)
+{
+  int     j, k;
+  __m128d w, a0, a1, a2, a3;
+  for (k=0; k+8<=n_y; k+=8)
+  {
+    a0 = a1 = a2 = a3 = _mm_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      w  = _mm_set1_pd(u[j]);
+      a0 = _mm_add_pd(a0, _mm_mul_pd(w, _mm_loadu_pd(x+k+j  )));
+      a1 = _mm_add_pd(a1, _mm_mul_pd(w, _mm_loadu_pd(x+k+j+2)));
+      a2 = _mm_add_pd(a2, _mm_mul_pd(w, _mm_loadu_pd(x+k+j+4)));
+      a3 = _mm_add_pd(a3, _mm_mul_pd(w, _mm_loadu_pd(x+k+j+6)));
+    }
+    _mm_storeu_pd(y+k  , a0);
+    _mm_storeu_pd(y+k+2, a1);
+    _mm_storeu_pd(y+k+4, a2);
+    _mm_storeu_pd(y+k+6, a3);
+  }
+  CorrelateRowGeneric(u, n_u, x+k, y+k, n_y-k);
+}
+__attribute__((target("avx2,fma")))
+void CorrelateRowAVX2(const double *u, int n_u, 
+    const double *x, double *y, int n_y)
+{
+  int     j, k;
+  __m256d w, a0, a1, a2, a3;
+  for (k=0; k+16<=n_y; k+=16)
+  {
+    a0 = a1 = a2 = a3 = _mm256_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      w  = _mm256_broadcast_sd(u+j);
+      a0 = _mm256_fmadd_pd(w, _mm256_loadu_pd(x+k+j   ), a0);
+      a1 = _mm256_fmadd_pd(w, _mm256_loadu_pd(x+k+j+ 4), a1);
+      a2 = _mm256_fmadd_pd(w, _mm256_loadu_pd(x+k+j+ 8), a2);
+      a3 = _mm256_fmadd_pd(w, _mm256_loadu_pd(x+k+j+12), a3);
+    }
+    _mm256_storeu_pd(y+k   , a0);
+    _mm256_storeu_pd(y+k+ 4, a1);
+    _mm256_storeu_pd(y+k+ 8, a2);
+    _mm256_storeu_pd(y+k+12, a3);
+  }
+  for (; k+4<=n_y; k+=4)
+  {
+    a0 = _mm256_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      a0 = _mm256_fmadd_pd(_mm256_broadcast_sd(u+j), 
+          _mm256_loadu_pd(x+k+j), a0);
+    }
+    _mm256_storeu_pd(y+k, a0);
+  }
+  CorrelateRowGeneric(u, n_u, x+k, y+k, n_y-k);
+}
+__attribute__((target("avx512f")))
+void CorrelateRowAVX512(const double *u, int n_u, 
+    const double *x, double *y, int n_y)
+{
+  int     j, k;
+  __m512d w, a0, a1, a2, a3;
+  for (k=0; k+32<=n_y; k+=32)
+  {
+    a0 = a1 = a2 = a3 = _mm512_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      w  = _mm512_set1_pd(u[j]);
+      a0 = _mm512_fmadd_pd(w, _mm512_loadu_pd(x+k+j   ), a0);
+      a1 = _mm512_fmadd_pd(w, _mm512_loadu_pd(x+k+j+ 8), a1);
+      a2 = _mm512_fmadd_pd(w, _mm512_loadu_pd(x+k+j+16), a2);
+      a3 = _mm512_fmadd_pd(w, _mm512_loadu_pd(x+k+j+24), a3);
+    }
+    _mm512_storeu_pd(y+k   , a0);
+    _mm512_storeu_pd(y+k+ 8, a1);
+    _mm512_storeu_pd(y+k+16, a2);
+    _mm512_storeu_pd(y+k+24, a3);
+  }
+  for (; k+8<=n_y; k+=8)
+  {
+    a0 = _mm512_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      a0 = _mm512_fmadd_pd(_mm512_set1_pd(u[j]), 
+          _mm512_loadu_pd(x+k+j), a0);
+    }
+    _mm512_storeu_pd(y+k, a0);
+  }
+  CorrelateRowGeneric(u, n_u, x+k, y+k, n_y-k);
+}
+#endif
+// the same in float, with twice the elements in a vector
+void CorrelateRowGenericF(const float *u, int n_u, 
+    const float *x, float *y, int n_y)
+{
+  int   j, k;
+  float sum;
+  for (k=0; k<n_y; k++)
+  {
+    sum = 0.0f;
+#pragma omp simd reduction(+:sum)
+    for (j=0; j<n_u; j++)
+    {
+      sum += u[j]*x[k+j];
+    }
+    y[k] = sum;
+  }
+}
+#ifdef SIMD_X86
+__attribute__((target("sse2")))
+void CorrelateRowSSE2F(const float *u, int n_u, 
+    const float *x, float *y, int n_y)
+{
+  int    j, k;
+  __m128 w, a0, a1, a2, a3;
+  for (k=0; k+16<=n_y; k+=16)
+  {
+    a0 = a1 = a2 = a3 = _mm_setzero_ps();
+    for (j=0; j<n_u; j++)
+    {
+      w  = _mm_set1_ps(u[j]);
+      a0 = _mm_add_ps(a0, _mm_mul_ps(w, _mm_loadu_ps(x+k+j   )));
+      a1 = _mm_add_ps(a1, _mm_mul_ps(w, _mm_loadu_ps(x+k+j+ 4)));
+      a2 = _mm_add_ps(a2, _mm_mul_ps(w, _mm_loadu_ps(x+k+j+ 8)));
+      a3 = _mm_add_ps(a3, _mm_mul_ps(w, _mm_loadu_ps(x+k+j+12)));
+    }
+    _mm_storeu_ps(y+k   , a0);
+    _mm_storeu_ps(y+k+ 4, a1);
+    _mm_storeu_ps(y+k+ 8, a2);
+    _mm_storeu_ps(y+k+12, a3);
+  }
+  CorrelateRowGenericF(u, n_u, x+k, y+k, n_y-k);
+}
+__attribute__((target("avx2,fma")))
+void CorrelateRowAVX2F(const float *u, int n_u, 
+    const float *x, float *y, int n_y)
+{
+  int    j, k;
+  __m256 w, a0, a1, a2, a3;
+  for (k=0; k+32<=n_y; k+=32)
+  {
+    a0 = a1 = a2 = a3 = _mm256_setzero_ps();
+    for (j=0; j<n_u; j++)
+    {
+      w  = _mm256_broadcast_ss(u+j);
+      a0 = _mm256_fmadd_ps(w, _mm256_loadu_ps(x+k+j   ), a0);
+      a1 = _mm256_fmadd_ps(w, _mm256_loadu_ps(x+k+j+ 8), a1);
+      a2 = _mm256_fmadd_ps(w, _mm256_loadu_ps(x+k+j+16), a2);
+      a3 = _mm256_fmadd_ps(w, _mm256_loadu_ps(x+k+j+24), a3);
+    }
+    _mm256_storeu_ps(y+k   , a0);
+    _mm256_storeu_ps(y+k+ 8, a1);
+    _mm256_storeu_ps(y+k+16, a2);
+    _mm256_storeu_ps(y+k+24, a3);
+  }
+  for (; k+8<=n_y; k+=8)
+  {
+    a0 = _mm256_setzero_ps();
+    for (j=0; j<n_u; j++)
+    {
+      a0 = _mm256_fmadd_ps(_mm256_broadcast_ss(u+j), 
+          _mm256_loadu_ps(x+k+j), a0);
+    }
+    _mm256_storeu_ps(y+k, a0);
+  }
+  CorrelateRowGenericF(u, n_u, x+k, y+k, n_y-k);
+}
+__attribute__((target("avx512f")))
+void CorrelateRowAVX512F(const float *u, int n_u, 
+    const float *x, float *y, int n_y)
+{
+  int    j, k;
+  __m512 w, a0, a1, a2, a3;
+  for (k=0; k+64<=n_y; k+=64)
+  {
+    a0 = a1 = a2 = a3 = _mm512_setzero_ps();
+    for (j=0; j<n_u; j++)
+    {
+      w  = _mm512_set1_ps(u[j]);
+      a0 = _mm512_fmadd_ps(w, _mm512_loadu_ps(x+k+j   ), a0);
+      a1 = _mm512_fmadd_ps(w, _mm512_loadu_ps(x+k+j+16), a1);
+      a2 = _mm512_fmadd_ps(w, _mm512_loadu_ps(x+k+j+32), a2);
+      a3 = _mm512_fmadd_ps(w, _mm512_loadu_ps(x+k+j+48), a3);
+    }
+    _mm512_storeu_ps(y+k   , a0);
+    _mm512_storeu_ps(y+k+16, a1);
+    _mm512_storeu_ps(y+k+32, a2);
+    _mm512_storeu_ps(y+k+48, a3);
+  }
+  for (; k+16<=n_y; k+=16)
+  {
+    a0 = _mm512_setzero_ps();
+    for (j=0; j<n_u; j++)
+    {
+      a0 = _mm512_fmadd_ps(_mm512_set1_ps(u[j]), 
+          _mm512_loadu_ps(x+k+j), a0);
+    }
+    _mm512_storeu_ps(y+k, a0);
+  }
+  CorrelateRowGenericF(u, n_u, x+k, y+k, n_y-k);
+}
+#endif
+  /**************************************************************
+     Fast Fourier transform of real arrays
+  **************************************************************/
+// in-place radix-2 transform of n complex numbers
+//   (twiddle[stride*k] = exp(-2*pi*i*k/n), without normalization)
+void TransformComplexFFT(int n, double *z, 
+    const int *bitrev, const double *twiddle, int stride,
+    int inverse)
+{
+  int    i, j, k, len, hlf, step;
+  double wr, wi, xr, xi, tmp;
+  for (i=0; i<n; i++)
+  {
+    j = bitrev[i];
+    if (i < j)
+    {
+      tmp = z[2*i  ]; z[2*i  ] = z[2*j  ]; z[2*j  ] = tmp;
+      tmp = z[2*i+1]; z[2*i+1] = z[2*j+1]; z[2*j+1] = tmp;
+    }
+  }
+  for (len=2; len<=n; len*=2)
+  {
+    hlf  = len/2;
+    step = stride*(n/len);
+    for (i=0; i<n; i+=len)
+    {
+      for (k=0; k<hlf; k++)
+      {
+        wr = twiddle[2*step*k];
+        wi = (inverse) ? -twiddle[2*step*k+1] : twiddle[2*step*k+1];
+        j  = i + k + hlf;
+        xr = z[2*j]*wr - z[2*j+1]*wi;
+        xi = z[2*j]*wi + z[2*j+1]*wr;
+        z[2*j  ]  = z[2*(i+k)  ] - xr;
+        z[2*j+1]  = z[2*(i+k)+1] - xi;
+        z[2*(i+k)  ] += xr;
+        z[2*(i+k)+1] += xi;
+      }
+    }
+  }
+}
+// spc[k] (k<=n_fft/2) of the real array x[n_fft]
+//   through the complex transform of n_fft/2 points
+void TransformRealFFT(ConvPlan *plan, double *x, double *spc)
+{
+  int    k, n_hlf = plan->n_fft/2;
+  double e_re, e_im, o_re, o_im, wr, wi;
+  const double *w = plan->twiddle;
+  TransformComplexFFT(n_hlf, x, plan->bitrev, w, 2, 0);
+  spc[0] = x[0] + x[1]; spc[1] = 0.0;
+  spc[2*n_hlf] = x[0] - x[1]; spc[2*n_hlf+1] = 0.0;
+  for (k=1; k<n_hlf; k++)
+  {
+    // split into the spectra of the even and the odd elements
+    e_re = 0.5*(x[2*k  ] + x[2*(n_hlf-k)  ]);
+    e_im = 0.5*(x[2*k+1] - x[2*(n_hlf-k)+1]);
+    o_re = 0.5*(x[2*k+1] + x[2*(n_hlf-k)+1]);
+    o_im = 0.5*(x[2*(n_hlf-k)] - x[2*k]);
+    wr = w[2*k]; wi = w[2*k+1];
+    spc[2*k  ] = e_re + o_re*wr - o_im*wi;
+    spc[2*k+1] = e_im + o_re*wi + o_im*wr;
+  }
+}
+// x[n_fft] multiplied by n_fft from the spectrum spc[k] (k<=n_fft/2)
+void InverseRealFFT(ConvPlan *plan, double *spc, double *x)
+{
+  int    k, n_hlf = plan->n_fft/2;
+  double e_re, e_im, d_re, d_im, o_re, o_im, wr, wi;
+  const double *w = plan->twiddle;
+  for (k=0; k<n_hlf; k++)
+  {
+    e_re = spc[2*k  ] + spc[2*(n_hlf-k)  ];
+    e_im = spc[2*k+1] - spc[2*(n_hlf-k)+1];
+    d_re = spc[2*k  ] - spc[2*(n_hlf-k)  ];
+    d_im = spc[2*k+1] + spc[2*(n_hlf-k)+1];
+    // multiply the odd part by exp(+2*pi*i*k/n_fft)
+    wr = w[2*k]; wi = -w[2*k+1];
+    o_re = d_re*wr - d_im*wi;
+    o_im = d_re*wi + d_im*wr;
+    x[2*k  ] = e_re - o_im;
+    x[2*k+1] = e_im + o_re;
+  }
+  TransformComplexFFT(n_hlf, x, plan->bitrev, w, 2, 1);
 }
   /**************************************************************
      Allocate & deallocate matrix 
@@ -87,6 +87,7 @@
 #include<stdlib.h>
 #include<time.h>
 #include<sys/time.h>
+#include<sys/resource.h>
 #include<sys/stat.h>
 #include<omp.h>
 #define DEBUG_PRINT_INT(a) (printf("%s: %d\n", #a, a))
@@ -46,6 +46,14 @@
     offset_t determines the lower limit of dwell time.
     This should be more than zero, and can consider
     the minimum duration in transfer of the stage.
+  simd_mode:
+    simd_mode selects the vector instructions 
+    in the convolution.
+    SIMD_AUTO chooses the widest ones of the running CPU
+    among SSE2, AVX2 (with FMA) and AVX-512,
+    so that the same executable runs on any x86 machine.
+    The others force the instructions, and SIMD_GENERIC 
+    leaves the vectorization to the compiler.
 
 // Descritption of some macro parameters 
   N_LOOPMAX:
@@ -73,6 +81,11 @@
 #include<stdlib.h>
 #include<time.h>
 #include<sys/time.h>
+#include<sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include<immintrin.h>
+#endif
 #define DEBUG_PRINT_INT(a) (printf("%s: %d\n", #a, a))
 #define DEBUG_PRINT_DBL(a) (printf("%s: %30.24lf\n", #a, a))
 #define SPRINTF_FILENAME(filename, state,  a) \
@@ -95,7 +108,11 @@
 #define N_ntgt 1
 #define N_nuni 2
 #define N_nall 3
-
+#define SIMD_AUTO    0
+#define SIMD_GENERIC 1
+#define SIMD_SSE2    2
+#define SIMD_AVX2    3
+#define SIMD_AVX512  4
 
 // Initialize the number of data and all the arrays
 int    InitDisplay(int n_tgt, int n_uni, int hn_uni, int n_all,
@@ -127,6 +144,21 @@ int    WriteAllAndHeader(int ni, int nj, char *filepath,
 int    WritePartAndHeader(int n_all, int n_tgt, int n_uni, 
           int nj, char *filepath, 
           double **aa, char **bb, double *c);
+// Vectorized kernels, y[k] = sum_j u[j]*x[k+j] (k<n_y, j<n_u)
+typedef void (*CorrelateRow)(const double *u, int n_u, 
+          const double *x, double *y, int n_y);
+int    DetectSIMD(void);
+CorrelateRow SelectCorrelateRow(int simd);
+void   CorrelateRowGeneric(const double *u, int n_u, 
+          const double *x, double *y, int n_y);
+#ifdef SIMD_X86
+void   CorrelateRowSSE2(const double *u, int n_u, 
+          const double *x, double *y, int n_y);
+void   CorrelateRowAVX2(const double *u, int n_u, 
+          const double *x, double *y, int n_y);
+void   CorrelateRowAVX512(const double *u, int n_u, 
+          const double *x, double *y, int n_y);
+#endif
 // Allocate & deallocate matrix
 void   **AllocateMatrix(int size, int m, int n);
 void   DeallocateMatrix(double **aa           );
@@ -149,6 +181,7 @@ int main (int argc, char *argv[])
   const double lim_alpha = 1.0E-6;
   double       threshold = 0.1;
   const double offset_t = 300.0; // in ms
+  const int    simd_mode = SIMD_AUTO;
   /**************************************************************
     Some useful arguments (change them where necessary)
   **************************************************************/
@@ -173,6 +206,8 @@ int main (int argc, char *argv[])
     Arrays to deconvolute the input data
    **************************************************************/
   double *target,*real_fig,*error,*dwelltime,*update,*unit,*info;
+  double *unit_rev,*pad_buf;
+  CorrelateRow correlate_row;
   double **memory,**fig_hst,**err_hst,**tm_hst;
   char   **columns,**hst_info;
   /**************************************************************
@@ -200,6 +235,9 @@ int main (int argc, char *argv[])
   dwelltime = (double*) AllocateVector(sizeof(double), n_all );
   update    = (double*) AllocateVector(sizeof(double), n_all );
   unit      = (double*) AllocateVector(sizeof(double), n_uni );
+  unit_rev  = (double*) AllocateVector(sizeof(double), n_uni );
+  pad_buf   = (double*) AllocateVector(sizeof(double), 
+                n_all+n_uni);
   info      = (double*) AllocateVector(sizeof(double), N_INFO);
   memory    = (double**)AllocateMatrix(sizeof(double),
                 n_all, N_ARRAYS);
@@ -226,6 +264,11 @@ int main (int argc, char *argv[])
   InitMatrixToDblZero(n_all, 2 +  N_LOOPMAX / N_LOOPREC,  tm_hst);
   ReadInputDat(target, &n_tgt, unit, &n_uni, dwelltime, 
       offset_t, &n_all, &hn_uni, infilepth_tgt, infilepth_uni);
+  for (j=0; j<n_uni; j++)
+  {
+    unit_rev[j] = unit[n_uni-1-j];
+  }
+  correlate_row = SelectCorrelateRow(simd_mode);
   init_en = GetCPUTime();
   InitDisplay(n_tgt,n_uni,hn_uni,n_all,init_st,init_en);
   /**************************************************************
@@ -258,21 +301,17 @@ int main (int argc, char *argv[])
       printf("loop: %9d, alpha: %9.4lf, rms: %9.4lf\n",
           cnt, alpha, rms_aft);
     } 
-    // intialize the arrays
-    for (i=0; i<n_all; i++)
+    // convolute the unit sputter yield with the dwell time
+    //   real_fig[k] = sum_j unit_rev[j]*pad_buf[k+j]
+    for (i=0; i<n_all+n_uni; i++)
     {
-      real_fig[i] = 0.0;
-      update[i] = 0.0;
+      pad_buf[i] = 0.0;
     }
-    // convolute the unit sputter yield with the dwell time
     for (i=s_cnt; i<e_cnt; i++)
     {
-      for (j=0; j<n_uni; j++)
-      {
-        tmp            = i - hn_uni + j;
-        real_fig[tmp] += (dwelltime[i]*unit[j]);
-      }
+      pad_buf[i+hn_uni] = dwelltime[i];
     }
+    correlate_row(unit_rev, n_uni, pad_buf, real_fig, n_all);
     // calculate the errors between the target and the figure
     rms_bef = rms_aft;  
     rms_aft = 0.0;
@@ -298,14 +337,16 @@ int main (int argc, char *argv[])
     else
     {
       // calculate the evaluation function (err x unit)
+      //   update[k] = sum_j unit_rev[j]*pad_buf[k+j]
+      for (i=0; i<n_all+n_uni; i++)
+      {
+        pad_buf[i] = 0.0;
+      }
       for (i=0; i<n_tgt; i++)
       {
-        for (j=0; j<n_uni; j++)
-        {
-          tmp = i + n_uni - hn_uni + j;
-          update[tmp] += (error[i]*unit[j]); // why?
-        }
+        pad_buf[i+n_uni+hn_uni] = error[i];
       }
+      correlate_row(unit_rev, n_uni, pad_buf, update, n_all);
       // refresh the dwelltime using (t=t-alpha × (p-f))
       for (i=0; i<n_all; i++)
       {
@@ -355,6 +396,8 @@ int main (int argc, char *argv[])
   DeallocateVector( dwelltime );
   DeallocateVector( update    );
   DeallocateVector( unit      );
+  DeallocateVector( unit_rev  );
+  DeallocateVector( pad_buf   );
   DeallocateVector( info      );
   DeallocateMatrix( memory    );
   DeallocateMatrix( fig_hst   );
@@ -677,6 +720,151 @@ int WritePartAndHeader(int n_all, int n_tgt, int n_uni, int nj,
   fclose(fp);
   return 0;
 }
+  /**************************************************************
+     Vectorized kernels, y[k] = sum_j u[j]*x[k+j]
+  **************************************************************/
+int DetectSIMD(void)
+{
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2") && 
+      __builtin_cpu_supports("fma")) return SIMD_AVX2;
+  if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+  return SIMD_GENERIC;
+}
+CorrelateRow SelectCorrelateRow(int simd)
+{
+  int simd_cpu;
+  const char *simd_name[] = {"auto","generic","sse2","avx2","avx512"};
+  simd_cpu = DetectSIMD();
+  if (simd == SIMD_AUTO) simd = simd_cpu;
+  if (simd > simd_cpu)
+  {
+    printf("%s is not supported by this CPU.\n", simd_name[simd]);
+    simd = simd_cpu;
+  }
+  printf("Vector instructions: %s\n", simd_name[simd]);
+#ifdef SIMD_X86
+  if (simd == SIMD_SSE2  ) return CorrelateRowSSE2;
+  if (simd == SIMD_AVX2  ) return CorrelateRowAVX2;
+  if (simd == SIMD_AVX512) return CorrelateRowAVX512;
+#endif
+  return CorrelateRowGeneric;
+}
+void CorrelateRowGeneric(const double *u, int n_u, 
+    const double *x, double *y, int n_y)
+{
+  int    j, k;
+  double sum;
+  for (k=0; k<n_y; k++)
+  {
+    sum = 0.0;
+#pragma omp simd reduction(+:sum)
+    for (j=0; j<n_u; j++)
+    {
+      sum += u[j]*x[k+j];
+    }
+    y[k] = sum;
+  }
+}
+#ifdef SIMD_X86
+// each vector holds successive elements of y,
+//   and four vectors are accumulated at once to hide the latency
+__attribute__((target("sse2")))
+void CorrelateRowSSE2(const double *u, int n_u, 
+    const double *x, double *y, int n_y)
+{
+  int     j, k;
+  __m128d w, a0, a1, a2, a3;
+  for (k=0; k+8<=n_y; k+=8)
+  {
+    a0 = a1 = a2 = a3 = _mm_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      w  = _mm_set1_pd(u[j]);
+      a0 = _mm_add_pd(a0, _mm_mul_pd(w, _mm_loadu_pd(x+k+j  )));
+      a1 = _mm_add_pd(a1, _mm_mul_pd(w, _mm_loadu_pd(x+k+j+2)));
+      a2 = _mm_add_pd(a2, _mm_mul_pd(w, _mm_loadu_pd(x+k+j+4)));
+      a3 = _mm_add_pd(a3, _mm_mul_pd(w, _mm_loadu_pd(x+k+j+6)));
+    }
+    _mm_storeu_pd(y+k  , a0);
+    _mm_storeu_pd(y+k+2, a1);
+    _mm_storeu_pd(y+k+4, a2);
+    _mm_storeu_pd(y+k+6, a3);
+  }
+  CorrelateRowGeneric(u, n_u, x+k, y+k, n_y-k);
+}
+__attribute__((target("avx2,fma")))
+void CorrelateRowAVX2(const double *u, int n_u, 
+    const double *x, double *y, int n_y)
+{
+  int     j, k;
+  __m256d w, a0, a1, a2, a3;
+  for (k=0; k+16<=n_y; k+=16)
+  {
+    a0 = a1 = a2 = a3 = _mm256_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      w  = _mm256_broadcast_sd(u+j);
+      a0 = _mm256_fmadd_pd(w, _mm256_loadu_pd(x+k+j   ), a0);
+      a1 = _mm256_fmadd_pd(w, _mm256_loadu_pd(x+k+j+ 4), a1);
+      a2 = _mm256_fmadd_pd(w, _mm256_loadu_pd(x+k+j+ 8), a2);
+      a3 = _mm256_fmadd_pd(w, _mm256_loadu_pd(x+k+j+12), a3);
+    }
+    _mm256_storeu_pd(y+k   , a0);
+    _mm256_storeu_pd(y+k+ 4, a1);
+    _mm256_storeu_pd(y+k+ 8, a2);
+    _mm256_storeu_pd(y+k+12, a3);
+  }
+  for (; k+4<=n_y; k+=4)
+  {
+    a0 = _mm256_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      a0 = _mm256_fmadd_pd(_mm256_broadcast_sd(u+j), 
+          _mm256_loadu_pd(x+k+j), a0);
+    }
+    _mm256_storeu_pd(y+k, a0);
+  }
+  CorrelateRowGeneric(u, n_u, x+k, y+k, n_y-k);
+}
+__attribute__((target("avx512f")))
+void CorrelateRowAVX512(const double *u, int n_u, 
+    const double *x, double *y, int n_y)
+{
+  int     j, k;
+  __m512d w, a0, a1, a2, a3;
+  for (k=0; k+32<=n_y; k+=32)
+  {
+    a0 = a1 = a2 = a3 = _mm512_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      w  = _mm512_set1_pd(u[j]);
+      a0 = _mm512_fmadd_pd(w, _mm512_loadu_pd(x+k+j   ), a0);
+      a1 = _mm512_fmadd_pd(w, _mm512_loadu_pd(x+k+j+ 8), a1);
+      a2 = _mm512_fmadd_pd(w, _mm512_loadu_pd(x+k+j+16), a2);
+      a3 = _mm512_fmadd_pd(w, _mm512_loadu_pd(x+k+j+24), a3);
+    }
+    _mm512_storeu_pd(y+k   , a0);
+    _mm512_storeu_pd(y+k+ 8, a1);
+    _mm512_storeu_pd(y+k+16, a2);
+    _mm512_storeu_pd(y+k+24, a3);
+  }
+  for (; k+8<=n_y; k+=8)
+  {
+    a0 = _mm512_setzero_pd();
+    for (j=0; j<n_u; j++)
+    {
+      a0 = _mm512_fmadd_pd(_mm512_set1_pd(u[j]), 
+          _mm512_loadu_pd(x+k+j), a0);
+    }
+    _mm512_storeu_pd(y+k, a0);
+  }
+  CorrelateRowGeneric(u, n_u, x+k, y+k, n_y-k);
+}
+#endif
   /**************************************************************
      Allocate & deallocate matrix 
   **************************************************************/